@@ -0,0 +1,110 @@
+// One island of a multi-process fleet. Start one process per island, e.g.
+//   for i in 0 1 2 3; do ./build/islandWorker --island $i --islands 4 --n 10 --l 3.9 --seconds 60 & done
+// The instance and GA settings take the same options as the headless solver.
+// Islands exchange elites through a shared-memory segment (default) or Unix-domain sockets
+// (--transport socket), so any of them can crash or be killed without affecting the others.
+
+#include <tools/evolution.h>
+#include <tools/IslandTransport.h>
+#include <tools/RunOptions.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+void usage() {
+    printf("Usage: islandWorker --island ID --islands COUNT [--transport shm|socket] [--name NAME]\n"
+           "                    [--socket-dir DIR] [--topology ring|random|full]\n"
+           "                    [--n N] [--l L] [--generations G] [--seconds S] [--seed SEED]\n"
+           "                    [--threads T] [--target FITNESS] [--population P] [--mutation-rate R]\n"
+           "                    [--elitism-rate R] [--predation-rate R] [--tournament-size K]\n"
+           "Stops at the first of: G generations, S seconds (default 10 without G), best fitness <= FITNESS\n"
+           "(default 0). Islands only take migrants from islands with the same N and L.\n");
+}
+
+template<int N, class Transport>
+int run(Transport& transport, unsigned int island, unsigned int island_count, MigrationTopology topology,
+        const RunOptions& options) {
+    ThreadPool pool(options.thread_count);
+    seed_random_generators(pool, options.seed + 0xD1B54A32D192ED03ull * island); // Distinct islands for one --seed
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    auto keep_going = [&](size_t generation) {
+        return (options.generation_limit == 0 || generation < options.generation_limit)
+               && (options.second_limit <= 0.0 || elapsed() < options.second_limit);
+    };
+    size_t generations, immigrations;
+    const BasicPopulation<N> population = evolve_process_island<N>(transport, pool, island, island_count, topology, options.target,
+                                                                   keep_going, generations, immigrations);
+    const double seconds = elapsed();
+
+    printf("island=%u n=%zu l=%.9g generations=%zu immigrations=%zu seconds=%.3f best_fitness=%.9g\n",
+           island, population.best().size(), static_cast<double>(ga_parameters.box_side_length), generations, immigrations,
+           seconds, population.best().fitness);
+    const BasicGene<N>& best = population.best();
+    for (size_t i = 0; i < best.size(); ++i) {
+        printf("%f %f %f %f\n", best.data[i].c.x, best.data[i].c.y, best.data[i].t, best.data[i].l);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    unsigned int island = 0, island_count = 0;
+    std::string transport_name = "shm", name = "box-fitting", socket_dir = "/tmp";
+    MigrationTopology topology = MigrationTopology::Ring;
+    RunOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) { usage(); return 1; }
+        const char* value = argv[++i];
+        if (parseRunOption(option, value, options)) continue;
+        if (option == "--island") island = atoi(value);
+        else if (option == "--islands") island_count = atoi(value);
+        else if (option == "--transport") transport_name = value;
+        else if (option == "--name") name = value;
+        else if (option == "--socket-dir") socket_dir = value;
+        else if (option == "--topology") {
+            if (strcmp(value, "ring") == 0) topology = MigrationTopology::Ring;
+            else if (strcmp(value, "random") == 0) topology = MigrationTopology::Random;
+            else if (strcmp(value, "full") == 0) topology = MigrationTopology::FullyConnected;
+            else { usage(); return 1; }
+        }
+        else { usage(); return 1; }
+    }
+    if (island_count == 0 || island >= island_count) { usage(); return 1; }
+    if (transport_name != "shm" && transport_name != "socket") { usage(); return 1; }
+    if (options.generation_limit == 0 && options.second_limit <= 0.0) options.second_limit = 10.0;
+    if (!checkRunOptions(options)) return 1;
+    if (options.n > static_cast<int>(MAX_MIGRANT_SQUARES)) {
+        fprintf(stderr, "Process islands solve at most %u squares (MAX_MIGRANT_SQUARES)\n", MAX_MIGRANT_SQUARES);
+        return 1;
+    }
+
+    try {
+        return with_gene_size(options.n, [&](auto size) {
+            constexpr int N = decltype(size)::value;
+            if (transport_name == "shm") {
+                SharedMemoryTransport transport(name, island, island_count);
+                return run<N>(transport, island, island_count, topology, options);
+            }
+            SocketTransport transport(socket_dir, name, island, island_count);
+            return run<N>(transport, island, island_count, topology, options);
+        });
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
+
+#else
+
+int main() {
+    fprintf(stderr, "islandWorker needs POSIX shared memory and Unix-domain sockets\n");
+    return 1;
+}
+
+#endif
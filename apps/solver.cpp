@@ -0,0 +1,271 @@
+// Headless solver: runs the genetic algorithm at full speed with no window and prints the best packing
+// and run statistics as JSON, e.g.
+//   ./build/solver --n 17 --l 5 --seconds 30 --seed 42
+// With --search it looks for the smallest box instead, e.g.
+//   ./build/solver --n 10 --search auto --seconds 5
+// and with --variable-box it evolves the box side along with the squares, e.g.
+//   ./build/solver --n 10 --variable-box auto --seconds 5
+
+#include <tools/evolution.h>
+#include <tools/BoxSearch.h>
+#include <tools/VariableBox.h>
+#include <tools/RunOptions.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+void usage() {
+    fprintf(stderr, "Usage: solver [--n N] [--l L] [--generations G] [--seconds S] [--seed SEED]\n"
+                    "              [--threads T] [--target FITNESS] [--population P] [--mutation-rate R]\n"
+                    "              [--elitism-rate R] [--predation-rate R] [--tournament-size K] [--sweep L1,L2,...]\n"
+                    "              [--search auto|LOW,HIGH] [--tolerance T] [--warm-start 1|0]\n"
+                    "              [--variable-box auto|START] [--fuzz-kernels PAIRS] [--check-ranking G]\n"
+                    "Stops at the first of: G generations, S seconds, best fitness <= FITNESS (default 0).\n"
+                    "--sweep also scores the final population in each of the given boxes.\n"
+                    "--search bisects for the smallest feasible box between LOW and HIGH (auto: sqrt(N) and\n"
+                    "ceil(sqrt(N))) down to T (default 0.001); G and S then limit every stage.\n"
+                    "--variable-box evolves L too, from START (auto: ceil(sqrt(N))), with adaptive penalty\n"
+                    "weights, and reports the smallest feasible box found; only G and S stop it.\n"
+                    "--fuzz-kernels only checks every overlap kernel on PAIRS nearly coincident pairs and fails\n"
+                    "if the active one is off by more than 1e-4.\n"
+                    "--check-ranking only evolves G generations and fails if any ranking disagrees with exact\n"
+                    "scores of the same genes (see count_misranked in evolution.h).\n"
+                    "The overlap kernel is chosen through OVERLAP_KERNEL as in the visualizer.\n");
+}
+
+struct SolverOptions : RunOptions {
+    vector<number> sweep;
+    vector<number> search; // Empty: a single run at --l
+    number tolerance = 1e-3;
+    bool warm_start = true;
+    number variable_box = -1; // Starting side in variable-box mode: 0 for auto, negative when off
+};
+
+bool parseSides(const char* value, vector<number>& sides) {
+    for (char* end = const_cast<char*>(value); *end != '\0'; value = end + 1) {
+        sides.push_back(strtod(value, &end));
+        if (end == value || (*end != ',' && *end != '\0')) return false;
+        if (*end == '\0') break;
+    }
+    return true;
+}
+
+void printRunHeader(size_t n, const SolverOptions& options, const ThreadPool& pool, bool specialized) {
+    printf("{\n");
+    printf("  \"n\": %zu,\n  \"l\": %.9g,\n  \"seed\": %llu,\n  \"threads\": %u,\n", n, static_cast<double>(ga_parameters.box_side_length),
+           static_cast<unsigned long long>(options.seed), pool.size());
+    printf("  \"kernel\": \"%s\",\n  \"specialized\": %s,\n", active_overlap_kernel->name, specialized ? "true" : "false");
+}
+
+template<int N>
+void printSquaresAndClose(const BasicGene<N>& gene) {
+    printf("  \"squares\": [\n");
+    for (size_t i = 0; i < gene.size(); ++i) {
+        printf("    {\"x\": %.9g, \"y\": %.9g, \"t\": %.9g}%s\n", gene.data[i].c.x, gene.data[i].c.y, gene.data[i].t,
+               i + 1 < gene.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+template<int N>
+int search(const SolverOptions& options) {
+    ThreadPool pool(options.thread_count);
+    seed_random_generators(pool, options.seed);
+
+    BoxSearchSettings settings;
+    const number gene_size = N == DYNAMIC_GENE_SIZE ? ga_parameters.gene_size : N;
+    settings.low = options.search.empty() ? sqrt(gene_size) * SQUARE_SIDE_LENGTH : options.search[0];
+    settings.high = options.search.empty() ? ceil(sqrt(gene_size)) * SQUARE_SIDE_LENGTH : options.search[1];
+    settings.tolerance = options.tolerance;
+    settings.stage_generations = options.generation_limit;
+    settings.stage_seconds = options.second_limit;
+    settings.feasible_fitness = options.target;
+    settings.warm_start = options.warm_start;
+
+    const auto start = std::chrono::steady_clock::now();
+    const BoxSearchResult<N> result = search_minimal_box<N>(settings, pool);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t generations = 0;
+    for (const BoxSearchStage& stage : result.stages) generations += stage.generations;
+    printRunHeader(result.best.size(), options, pool, N != DYNAMIC_GENE_SIZE);
+    printf("  \"search_low\": %.9g,\n  \"search_high\": %.9g,\n  \"warm_start\": %s,\n", static_cast<double>(settings.low),
+           static_cast<double>(settings.high), settings.warm_start ? "true" : "false");
+    printf("  \"generations\": %zu,\n  \"seconds\": %.6f,\n", generations, seconds);
+    printf("  \"stages\": [\n");
+    for (size_t s = 0; s < result.stages.size(); ++s) {
+        const BoxSearchStage& stage = result.stages[s];
+        printf("    {\"l\": %.9g, \"feasible\": %s, \"proven_l\": %.9g, \"generations\": %zu, \"seconds\": %.6f, \"best_fitness\": %.9g}%s\n",
+               static_cast<double>(stage.box_side), stage.feasible ? "true" : "false", static_cast<double>(stage.proven_side),
+               stage.generations, stage.seconds, stage.best_fitness, s + 1 < result.stages.size() ? "," : "");
+    }
+    printf("  ],\n");
+    if (result.box_side <= 0) {
+        printf("  \"best_l\": null\n}\n");
+        fprintf(stderr, "No feasible packing in the upper bound %g; raise it or the stage limits\n", static_cast<double>(settings.high));
+        return 3;
+    }
+    printf("  \"best_l\": %.9g,\n", static_cast<double>(result.box_side));
+    printSquaresAndClose(result.best);
+    return 0;
+}
+
+int fuzzKernels(size_t pairs, uint64_t seed) {
+    gen.seed(seed);
+    std::array<double, std::size(overlap_kernels)> worst;
+    fuzzOverlapKernels(pairs, worst);
+    printf("{\n  \"pairs\": %zu,\n  \"seed\": %llu,\n  \"max_difference\": {", pairs, static_cast<unsigned long long>(seed));
+    for (size_t k = 0; k < worst.size(); ++k) printf("%s\"%s\": %.9g", k ? ", " : "", overlap_kernels[k].name, worst[k]);
+    printf("}\n}\n");
+    if (worst[active_overlap_kernel - overlap_kernels] <= 1e-4) return 0;
+    fprintf(stderr, "The %s kernel disagrees with the closed form on nearly coincident squares\n", active_overlap_kernel->name);
+    return 4;
+}
+
+// Evolves `generations` generations and re-scores every gene exactly after each one, to show that
+// bounded evaluation, which leaves some genes with only a lower bound, ranks them as exact scores would
+template<int N>
+int checkRanking(const SolverOptions& options, size_t generations) {
+    ThreadPool pool(options.thread_count);
+    seed_random_generators(pool, options.seed);
+    BasicPopulation<N> population(initializeGenes<N>());
+    size_t misranked = 0, unfinished = 0;
+    for (size_t g = 0; g < generations; ++g) {
+        population.evolve(pool);
+        misranked += count_misranked(population);
+        for (const BasicGene<N>& gene : population.genes) unfinished += gene.dirty;
+    }
+    const size_t genes = generations * population.genes.size();
+    printf("{\n  \"n\": %zu,\n  \"l\": %.9g,\n  \"seed\": %llu,\n  \"generations\": %zu,\n", population.best().size(),
+           static_cast<double>(ga_parameters.box_side_length), static_cast<unsigned long long>(options.seed), generations);
+    printf("  \"bounded_evaluation\": %s,\n  \"unfinished_genes\": %zu,\n  \"checked_genes\": %zu,\n  \"misranked_genes\": %zu\n}\n",
+           USE_BOUNDED_EVALUATION ? "true" : "false", unfinished, genes, misranked);
+    if (misranked == 0) return 0;
+    fprintf(stderr, "The ranking disagrees with exact scores\n");
+    return 5;
+}
+
+template<int N>
+int solveVariableBox(const SolverOptions& options) {
+    ThreadPool pool(options.thread_count);
+    seed_random_generators(pool, options.seed);
+    const number gene_size = N == DYNAMIC_GENE_SIZE ? ga_parameters.gene_size : N;
+    ga_parameters.box_side_length = options.variable_box > 0 ? options.variable_box : ceil(sqrt(gene_size)) * SQUARE_SIDE_LENGTH;
+
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    const VariableBoxResult<N> result = evolve_variable_box<N>(pool, [&](size_t generations) {
+        return (options.generation_limit == 0 || generations < options.generation_limit)
+               && (options.second_limit <= 0.0 || elapsed() < options.second_limit);
+    });
+    const double seconds = elapsed();
+
+    printRunHeader(result.best.size(), options, pool, N != DYNAMIC_GENE_SIZE);
+    printf("  \"generations\": %zu,\n  \"seconds\": %.6f,\n  \"generations_per_second\": %.1f,\n",
+           result.generations, seconds, seconds > 0 ? result.generations / seconds : 0.0);
+    printf("  \"weight_changes\": %zu,\n  \"overlap_weight\": %.9g,\n  \"out_of_bounds_weight\": %.9g,\n",
+           result.weight_changes, ga_parameters.overlap_weight, ga_parameters.out_of_bounds_weight);
+    if (!result.found) {
+        printf("  \"best_l\": null\n}\n");
+        fprintf(stderr, "No feasible packing found; start from a larger box or run longer\n");
+        return 3;
+    }
+    printf("  \"best_l\": %.9g,\n", static_cast<double>(result.best.box_side));
+    printSquaresAndClose(result.best);
+    return 0;
+}
+
+template<int N>
+int solve(const SolverOptions& options) {
+    ThreadPool pool(options.thread_count);
+    seed_random_generators(pool, options.seed);
+
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    BasicPopulation<N> population(initializeGenes<N>());
+    size_t generations = 0;
+    while (population.best().fitness > options.target
+           && (options.generation_limit == 0 || generations < options.generation_limit)
+           && (options.second_limit <= 0.0 || elapsed() < options.second_limit)) {
+        population.evolve(pool);
+        ++generations;
+    }
+    const double seconds = elapsed();
+
+    const BasicGene<N>& best = population.best();
+    printRunHeader(best.size(), options, pool, N != DYNAMIC_GENE_SIZE);
+    printf("  \"generations\": %zu,\n  \"seconds\": %.6f,\n  \"generations_per_second\": %.1f,\n",
+           generations, seconds, seconds > 0 ? generations / seconds : 0.0);
+    printf("  \"fitness_cache_lookups\": %llu,\n  \"fitness_cache_hits\": %llu,\n",
+           fitness_cache_counters.lookups(), fitness_cache_counters.hits());
+    printf("  \"best_fitness\": %.9g,\n  \"solved\": %s,\n", best.fitness, best.fitness <= 0.0 ? "true" : "false");
+    if (!options.sweep.empty()) {
+        vector<double> fitness;
+        evaluate_population_for_box_sides(population.genes, options.sweep, fitness, pool);
+        printf("  \"sweep\": [\n");
+        for (size_t b = 0; b < options.sweep.size(); ++b) {
+            double best_fitness = std::numeric_limits<double>::max();
+            for (size_t k = 0; k < population.genes.size(); ++k) {
+                best_fitness = std::min(best_fitness, fitness[k * options.sweep.size() + b]);
+            }
+            printf("    {\"l\": %.9g, \"best_fitness\": %.9g}%s\n", static_cast<double>(options.sweep[b]), best_fitness,
+                   b + 1 < options.sweep.size() ? "," : "");
+        }
+        printf("  ],\n");
+    }
+    printSquaresAndClose(best);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    bool searching = false;
+    size_t fuzz_pairs = 0;
+    size_t check_generations = 0;
+    SolverOptions options;
+    options.thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) { usage(); return 1; }
+        const char* value = argv[++i];
+        if (parseRunOption(option, value, options)) continue;
+        if (option == "--sweep") { if (!parseSides(value, options.sweep)) { usage(); return 1; } }
+        else if (option == "--search") {
+            searching = true;
+            if (std::string(value) != "auto" && (!parseSides(value, options.search) || options.search.size() != 2)) { usage(); return 1; }
+        }
+        else if (option == "--tolerance") options.tolerance = atof(value);
+        else if (option == "--warm-start") options.warm_start = atoi(value) != 0;
+        else if (option == "--fuzz-kernels") fuzz_pairs = strtoull(value, nullptr, 10);
+        else if (option == "--check-ranking") check_generations = strtoull(value, nullptr, 10);
+        else if (option == "--variable-box") {
+            options.variable_box = std::string(value) == "auto" ? 0 : atof(value);
+            if (options.variable_box < 0 || (options.variable_box == 0 && std::string(value) != "auto")) { usage(); return 1; }
+        }
+        else { usage(); return 1; }
+    }
+    try {
+        configureOverlapKernelsFromEnvironment();
+    } catch (const std::invalid_argument& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (fuzz_pairs > 0) return fuzzKernels(fuzz_pairs, options.seed);
+    if (searching && (options.tolerance <= 0 || (!options.search.empty() && options.search[0] >= options.search[1]))) {
+        fprintf(stderr, "--search needs LOW < HIGH and a positive --tolerance\n");
+        return 1;
+    }
+    if (options.generation_limit == 0 && options.second_limit <= 0.0 && check_generations == 0) {
+        fprintf(stderr, "Give a --generations or --seconds limit\n");
+        return 1;
+    }
+    if (!checkRunOptions(options)) return 1;
+
+    return with_gene_size(options.n, [&](auto size) {
+        if (check_generations > 0) return checkRanking<decltype(size)::value>(options, check_generations);
+        if (options.variable_box >= 0) return solveVariableBox<decltype(size)::value>(options);
+        return searching ? search<decltype(size)::value>(options) : solve<decltype(size)::value>(options);
+    });
+}
@@ -0,0 +1,117 @@
+#ifndef BOXSEARCH_H
+#define BOXSEARCH_H
+
+#include <chrono>
+#include <vector>
+#include <tools/evolution.h>
+#include <tools/ThreadPool.h>
+
+// Smallest container for N squares, by bisection over the side L. Every stage evolves until its best
+// packing is feasible (fitness at most feasible_fitness) or the stage limits run out, which counts as
+// infeasible. Stages are warm-started: the previous stage's population is rescaled into the new box,
+// so a stage starts from packings that are already nearly right instead of from random genes.
+struct BoxSearchSettings {
+    number low = 0;  // Not yet known to be feasible
+    number high = 0; // Should be feasible; the grid side ceil(sqrt(N)) always is
+    number tolerance = 1e-3; // Stop once high - low is at most this; must be positive
+    size_t stage_generations = 0; // Per-stage limits; 0 means none, but set at least one
+    double stage_seconds = 0.0;
+    double feasible_fitness = 0.0;
+    bool warm_start = true; // Off: every stage starts from a fresh random population
+    unsigned int probes = 8; // Smaller sides tried on the population after each feasible stage
+};
+
+struct BoxSearchStage {
+    number box_side;
+    bool feasible;
+    size_t generations;
+    double seconds;
+    double best_fitness;
+    number proven_side; // Smallest side a gene of the final population is feasible in, or 0
+};
+
+template<int N>
+struct BoxSearchResult {
+    number box_side = 0; // Smallest side found feasible; 0 if not even `high` was
+    BasicGene<N> best{UNINITIALIZED_GENE};
+    vector<BoxSearchStage> stages;
+};
+
+// Maps the genes from a box of side `from` into one of side `to` and rescores them in the new box
+template<int N>
+void rescale_genes(vector<BasicGene<N>>& genes, number from, number to) {
+    for (BasicGene<N>& gene : genes) {
+        rescale_squares(gene, from, to);
+        gene.calculateFitness();
+    }
+}
+
+// Runs the search with ga_parameters for everything but the side, which it sets for each stage and
+// leaves at the last stage's value
+template<int N>
+BoxSearchResult<N> search_minimal_box(const BoxSearchSettings& settings, ThreadPool& pool) {
+    BoxSearchResult<N> result;
+    number low = settings.low, high = settings.high;
+    number side = high; // The first stage checks the upper bound
+    vector<BasicGene<N>> genes;
+    number genes_side = 0;
+    vector<number> probes;
+    vector<double> probe_fitness;
+
+    while (true) {
+        ga_parameters.box_side_length = side;
+        if (genes.empty() || !settings.warm_start) {
+            genes = initializeGenes<N>();
+        } else {
+            rescale_genes(genes, genes_side, side);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+        BasicPopulation<N> population(std::move(genes));
+        size_t generations = 0;
+        while (population.best().fitness > settings.feasible_fitness
+               && (settings.stage_generations == 0 || generations < settings.stage_generations)
+               && (settings.stage_seconds <= 0.0 || elapsed() < settings.stage_seconds)) {
+            population.evolve(pool);
+            ++generations;
+        }
+        BoxSearchStage stage{ side, population.best().fitness <= settings.feasible_fitness, generations, elapsed(),
+                              population.best().fitness, 0 };
+
+        if (stage.feasible) {
+            stage.proven_side = side;
+            result.box_side = side;
+            result.best = population.best();
+            // The packing may already fit a smaller box as it is
+            probes.clear();
+            for (unsigned int p = 1; p <= settings.probes; ++p) probes.push_back(low + (side - low) * p / (settings.probes + 1));
+            evaluate_population_for_box_sides(population.genes, probes, probe_fitness, pool);
+            for (size_t b = 0; b < probes.size() && stage.proven_side == side; ++b) {
+                for (size_t k = 0; k < population.genes.size(); ++k) {
+                    if (probe_fitness[k * probes.size() + b] > settings.feasible_fitness) continue;
+                    stage.proven_side = result.box_side = probes[b];
+                    result.best = population.genes[k];
+                    break;
+                }
+            }
+            high = stage.proven_side;
+        } else {
+            if (side == settings.high) { // No feasible upper bound to bisect from
+                result.stages.push_back(stage);
+                return result;
+            }
+            low = side;
+        }
+        result.stages.push_back(stage);
+
+        genes = population.genes;
+        genes_side = side;
+        if (high - low <= settings.tolerance) break;
+        side = (low + high) / 2;
+        if (side == low || side == high) break; // No float left between them
+    }
+    return result;
+}
+
+#endif // BOXSEARCH_H
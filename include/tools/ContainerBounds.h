@@ -0,0 +1,23 @@
+#ifndef CONTAINERBOUNDS_H
+#define CONTAINERBOUNDS_H
+
+#include <tools/Square.h>
+#include <tools/SimdOverlap.h>
+
+// Area of `sq` lying outside the container [0, box_side]^2.
+// Almost every square is fully inside, which the rotated half-extent settles without any geometry.
+// Otherwise the container is just an axis-aligned square, so the closed-form pair kernel gives the
+// part that is inside.
+number areaOutsideBox(const Square& sq, number box_side) {
+    const number reach = (fabs(sq.cos_t) + fabs(sq.sin_t)) * sq.l / 2.0;
+    if (sq.c.x - reach >= 0 && sq.c.x + reach <= box_side &&
+        sq.c.y - reach >= 0 && sq.c.y + reach <= box_side) {
+        return 0.0;
+    }
+    const number half_box = box_side / 2.0;
+    const number inside = pairOverlapLanes<number>(half_box, half_box, 1, 0, half_box,
+                                                   sq.c.x, sq.c.y, sq.cos_t, sq.sin_t, sq.l / 2.0);
+    return max((number)0.0, sq.l * sq.l - inside);
+}
+
+#endif // CONTAINERBOUNDS_H
@@ -0,0 +1,55 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Data written by different threads is kept this far apart to avoid false sharing
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Event count with a single writing thread and any number of readers. An increment is a relaxed load
+// and store, with no locked read-modify-write.
+struct SingleWriterCounter {
+    std::atomic<unsigned long long> value{0};
+
+    void add(unsigned long long n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    unsigned long long load() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Statistics that every thread counts into a block of its own (Counts, usually SingleWriterCounters),
+// on its own cache line, and that are only summed when a report asks for them. Blocks outlive their
+// threads, so nothing is lost when a pool shuts down. A thread finds its block through a thread_local,
+// so keep a single instance per Counts type.
+template<class Counts>
+class PerThreadCounters {
+public:
+    Counts& local() {
+        thread_local Counts* counts = nullptr;
+        if (!counts) {
+            std::lock_guard<std::mutex> guard(mutex);
+            blocks.push_back(std::make_unique<Block>());
+            counts = &blocks.back()->counts;
+        }
+        return *counts;
+    }
+
+    // Calls f(const Counts&) for every thread's block
+    template<class F>
+    void forEach(F&& f) const {
+        std::lock_guard<std::mutex> guard(mutex);
+        for (const auto& block : blocks) f(block->counts);
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Block {
+        Counts counts;
+    };
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Block>> blocks;
+};
+
+#endif // COUNTERS_H
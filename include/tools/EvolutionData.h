@@ -27,7 +27,7 @@ class EvolutionData{
     EvolutionData(){
         data.reserve(100);
     }
-    void pushGeneration(pair<Gene,double> generation_data, size_t generation_number){
+    void pushGeneration(const pair<Gene,double>& generation_data, size_t generation_number){
         data.push_back(GenerationData(generation_data.first.fitness,generation_data.second,generation_number));
     }
     void write(const string filename){
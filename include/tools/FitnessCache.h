@@ -0,0 +1,91 @@
+#ifndef FITNESSCACHE_H
+#define FITNESSCACHE_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <tools/Square.h>
+#include <tools/Counters.h>
+
+// Order-dependent 64-bit hash step (multiply-xorshift, as in splitmix64's finalizer)
+inline uint64_t hashCombine(uint64_t hash, uint64_t value) {
+    hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 31;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    return hash ^ (hash >> 29);
+}
+
+// Hash of the squares' positions and angles, the only free parameters of a gene
+template<typename Squares>
+uint64_t hashSquares(uint64_t seed, const Squares& squares, size_t count) {
+    uint64_t hash = seed;
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t position = uint64_t(std::bit_cast<uint32_t>(squares[i].c.x)) << 32 | std::bit_cast<uint32_t>(squares[i].c.y);
+        hash = hashCombine(hash, position);
+        hash = hashCombine(hash, std::bit_cast<uint32_t>(squares[i].t));
+    }
+    return hash;
+}
+
+// Small direct-mapped table of recent scores, keyed by content hash. One per thread, so lookups
+// never synchronise; a colliding entry simply overwrites the older one.
+template<size_t SLOTS>
+class FitnessCache {
+public:
+    static_assert((SLOTS & (SLOTS - 1)) == 0, "SLOTS must be a power of two");
+
+    bool lookup(uint64_t key, double& fitness) const {
+        const Entry& entry = entries[key & (SLOTS - 1)];
+        if (entry.key != key) return false;
+        fitness = entry.fitness;
+        return true;
+    }
+
+    void store(uint64_t key, double fitness) {
+        entries[key & (SLOTS - 1)] = { key, fitness };
+    }
+
+private:
+    struct Entry {
+        uint64_t key = 0; // Keys are never 0, so a zeroed entry is empty
+        double fitness = 0.0;
+    };
+    std::array<Entry, SLOTS> entries{};
+};
+
+// How often the fitness cache saved an exact evaluation, over the whole run. Counted per thread, like
+// the caches themselves, and only summed for a report.
+struct FitnessCacheCounters {
+    void count(bool hit) {
+        Counts& counts = threads.local();
+        counts.lookups.add(1);
+        if (hit) counts.hits.add(1);
+    }
+    unsigned long long lookups() const { return total(&Counts::lookups); }
+    unsigned long long hits() const { return total(&Counts::hits); }
+
+    void report() const {
+        const unsigned long long lookup_count = lookups(), hit_count = hits();
+        if (lookup_count == 0) return;
+        printf("Fitness cache: %llu of %llu lookups hit (%.2f%%)\n", hit_count, lookup_count, 100.0 * hit_count / lookup_count);
+    }
+
+private:
+    struct Counts {
+        SingleWriterCounter lookups, hits;
+    };
+
+    unsigned long long total(SingleWriterCounter Counts::*counter) const {
+        unsigned long long sum = 0;
+        threads.forEach([&](const Counts& counts) { sum += (counts.*counter).load(); });
+        return sum;
+    }
+
+    PerThreadCounters<Counts> threads;
+};
+
+inline FitnessCacheCounters fitness_cache_counters;
+
+#endif // FITNESSCACHE_H
@@ -0,0 +1,288 @@
+#ifndef ISLANDTRANSPORT_H
+#define ISLANDTRANSPORT_H
+
+// Migration between islands that live in separate processes: a shared-memory ring for processes on
+// one machine, or Unix-domain datagram sockets. Either way an island only ever publishes and polls,
+// so a crashed process loses its own island and nothing else. POSIX only.
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <tools/evolution.h>
+#include <tools/Islands.h>
+
+constexpr unsigned int MAX_PROCESS_ISLANDS = 64;
+constexpr unsigned int ALL_ISLANDS = ~0u;
+constexpr unsigned int MAX_MIGRANT_SQUARES = 128; // Largest N a process island can solve
+
+// Plain-data form of a migrant. Only the squares travel; the receiver re-scores them, so the
+// fitness caches never cross a process boundary. Every N shares one layout, so islands solving
+// different instances can share a segment or socket directory and just ignore each other.
+struct MigrantRecord {
+    uint32_t gene_size;
+    uint32_t source;
+    uint32_t target; // An island id, or ALL_ISLANDS
+    uint32_t count;
+    float box_side;
+    float squares[MIGRANT_COUNT][MAX_MIGRANT_SQUARES][3]; // x, y, t of the first gene_size squares
+};
+
+template<int N>
+void packMigrants(const BasicPopulation<N>& population, unsigned int source, unsigned int target, MigrantRecord& record) {
+    record.gene_size = population.best().size();
+    record.source = source;
+    record.target = target;
+    record.count = MIGRANT_COUNT;
+    record.box_side = ga_parameters.box_side_length;
+    for (int m = 0; m < MIGRANT_COUNT; ++m) {
+        const BasicGene<N>& gene = population.genes[population.ranking[m]];
+        for (size_t i = 0; i < gene.size(); ++i) {
+            record.squares[m][i][0] = gene.data[i].c.x;
+            record.squares[m][i][1] = gene.data[i].c.y;
+            record.squares[m][i][2] = gene.data[i].t;
+        }
+    }
+}
+
+// Rebuilds and scores the migrants into genes[0..MIGRANT_COUNT); false for records from islands
+// solving another N or L, or from a build with a different MIGRANT_COUNT
+template<int N>
+bool unpackMigrants(const MigrantRecord& record, BasicGene<N>* genes) {
+    if (record.gene_size != genes[0].size() || record.count != MIGRANT_COUNT
+        || record.box_side != static_cast<float>(ga_parameters.box_side_length)) return false;
+    for (int m = 0; m < MIGRANT_COUNT; ++m) {
+        BasicGene<N>& gene = genes[m];
+        for (size_t i = 0; i < gene.size(); ++i) {
+            gene.data[i] = Square(Point(record.squares[m][i][0], record.squares[m][i][1]), record.squares[m][i][2], SQUARE_SIDE_LENGTH);
+            gene.markChanged(i);
+        }
+        gene.calculateFitness();
+    }
+    return true;
+}
+
+// A named shared-memory segment holding one outbox ring per island. Each outbox has a single writer
+// (its island) and any number of readers. Slots are guarded by a sequence number that is odd while
+// the slot is being written, so a reader that races the writer, or finds a slot a crashed writer
+// left half-written, simply skips it. Each outbox records the pid of its island, so the segment is
+// only reset or unlinked when no other island is alive; an island restarted after a crash rejoins it.
+class SharedMemoryTransport {
+public:
+    static constexpr uint64_t RING_SLOTS = 8;
+
+    SharedMemoryTransport(const std::string& name, unsigned int island, unsigned int island_count)
+        : name(name.front() == '/' ? name : "/" + name), island(island), island_count(island_count) {
+        if (island_count > MAX_PROCESS_ISLANDS || island >= island_count) throw std::invalid_argument("Island id out of range");
+        int fd = shm_open(this->name.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0) throw std::runtime_error("shm_open failed: " + std::string(strerror(errno)));
+        // Every process sizes the segment; the first ftruncate zero-fills it, which is a valid empty state
+        if (ftruncate(fd, sizeof(Segment)) != 0) {
+            close(fd);
+            throw std::runtime_error("ftruncate failed: " + std::string(strerror(errno)));
+        }
+        void* memory = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) throw std::runtime_error("mmap failed: " + std::string(strerror(errno)));
+        segment = static_cast<Segment*>(memory);
+        uint32_t layout = 0;
+        if (!segment->record_size.compare_exchange_strong(layout, sizeof(MigrantRecord)) && layout != sizeof(MigrantRecord)) {
+            munmap(segment, sizeof(Segment));
+            throw std::runtime_error("Shared memory segment " + this->name + " belongs to a build with a different migrant record layout");
+        }
+        segment->outboxes[island].owner.store(getpid(), std::memory_order_release);
+        // Rings left by a finished or crashed fleet are stale; a restarted island only resets its own
+        const bool stale = !othersAlive();
+        for (unsigned int id = 0; id < MAX_PROCESS_ISLANDS; ++id) {
+            if (id == island || stale) resetOutbox(segment->outboxes[id]);
+        }
+    }
+
+    // The last live island removes the segment name
+    ~SharedMemoryTransport() {
+        segment->outboxes[island].owner.store(0, std::memory_order_release);
+        if (!othersAlive()) shm_unlink(name.c_str());
+        munmap(segment, sizeof(Segment));
+    }
+
+    void send(const MigrantRecord& record) {
+        Outbox& own = segment->outboxes[island];
+        const uint64_t sequence = own.head.load(std::memory_order_relaxed);
+        Slot& slot = own.slots[sequence % RING_SLOTS];
+        slot.sequence.store(2 * sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&slot.record, &record, sizeof(MigrantRecord));
+        slot.sequence.store(2 * sequence + 2, std::memory_order_release);
+        own.head.store(sequence + 1, std::memory_order_release);
+    }
+
+    // Newest unread record addressed to this island from `source`, if any
+    bool receive(unsigned int source, MigrantRecord& record) {
+        Outbox& outbox = segment->outboxes[source];
+        const uint64_t head = outbox.head.load(std::memory_order_acquire);
+        uint64_t& next = next_sequence[source];
+        if (head < next) next = 0; // The source restarted
+        bool found = false;
+        for (uint64_t sequence = (head > next + RING_SLOTS) ? head - RING_SLOTS : next; sequence < head; ++sequence) {
+            Slot& slot = outbox.slots[sequence % RING_SLOTS];
+            if (slot.sequence.load(std::memory_order_acquire) != 2 * sequence + 2) continue;
+            memcpy(&scratch, &slot.record, sizeof(MigrantRecord));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != 2 * sequence + 2) continue; // Overwritten mid-copy
+            if (scratch.target != island && scratch.target != ALL_ISLANDS) continue;
+            record = scratch;
+            found = true;
+        }
+        next = head;
+        return found;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        MigrantRecord record;
+    };
+    struct alignas(CACHE_LINE_SIZE) Outbox {
+        std::atomic<int32_t> owner; // Pid of the island writing this outbox, 0 if none
+        std::atomic<uint64_t> head;
+        Slot slots[RING_SLOTS];
+    };
+    struct Segment {
+        std::atomic<uint32_t> record_size; // Set by the first process, checked by the rest
+        Outbox outboxes[MAX_PROCESS_ISLANDS];
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared-memory rings need address-free atomics");
+
+    static void resetOutbox(Outbox& outbox) {
+        outbox.head.store(0, std::memory_order_relaxed);
+        for (Slot& slot : outbox.slots) slot.sequence.store(0, std::memory_order_release);
+    }
+
+    // True if a process still owns another island's outbox. A reused pid only keeps the segment alive longer.
+    bool othersAlive() const {
+        for (unsigned int id = 0; id < MAX_PROCESS_ISLANDS; ++id) {
+            const pid_t pid = segment->outboxes[id].owner.load(std::memory_order_acquire);
+            if (id != island && pid > 0 && (kill(pid, 0) == 0 || errno == EPERM)) return true;
+        }
+        return false;
+    }
+
+    const std::string name;
+    const unsigned int island;
+    const unsigned int island_count;
+    Segment* segment = nullptr;
+    uint64_t next_sequence[MAX_PROCESS_ISLANDS] = {};
+    MigrantRecord scratch;
+};
+
+// One datagram socket per island, bound to <directory>/<name>-<island>.sock. Sends never block and
+// are dropped when the receiver is gone or its queue is full.
+class SocketTransport {
+public:
+    SocketTransport(const std::string& directory, const std::string& name, unsigned int island, unsigned int island_count)
+        : directory(directory), name(name), island(island), island_count(island_count) {
+        if (island_count > MAX_PROCESS_ISLANDS || island >= island_count) throw std::invalid_argument("Island id out of range");
+        const sockaddr_un address = addressOf(island);
+        fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (fd < 0) throw std::runtime_error("socket failed: " + std::string(strerror(errno)));
+        ::unlink(address.sun_path); // Left behind by a crashed run
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            throw std::runtime_error("bind failed: " + std::string(strerror(errno)));
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    ~SocketTransport() {
+        close(fd);
+        ::unlink(addressOf(island).sun_path);
+    }
+
+    void send(const MigrantRecord& record) {
+        for (unsigned int to = 0; to < island_count; ++to) {
+            if (to == island || (record.target != ALL_ISLANDS && record.target != to)) continue;
+            const sockaddr_un address = addressOf(to);
+            sendto(fd, &record, sizeof(record), 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        }
+    }
+
+    // Drains the socket; keeps the newest record from `source`, if any
+    bool receive(unsigned int source, MigrantRecord& record) {
+        MigrantRecord incoming;
+        while (recv(fd, &incoming, sizeof(incoming), 0) == static_cast<ssize_t>(sizeof(incoming))) {
+            if (incoming.source < MAX_PROCESS_ISLANDS) {
+                pending[incoming.source] = incoming;
+                has_pending[incoming.source] = true;
+            }
+        }
+        if (source >= MAX_PROCESS_ISLANDS || !has_pending[source]) return false;
+        record = pending[source];
+        has_pending[source] = false;
+        return true;
+    }
+
+private:
+    sockaddr_un addressOf(unsigned int id) const {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        const std::string path = directory + "/" + name + "-" + std::to_string(id) + ".sock";
+        if (path.size() >= sizeof(address.sun_path)) throw std::invalid_argument("Socket path too long: " + path);
+        strcpy(address.sun_path, path.c_str());
+        return address;
+    }
+
+    const std::string directory;
+    const std::string name;
+    const unsigned int island;
+    const unsigned int island_count;
+    int fd = -1;
+    MigrantRecord pending[MAX_PROCESS_ISLANDS];
+    bool has_pending[MAX_PROCESS_ISLANDS] = {};
+};
+
+// Evolves one island of a multi-process fleet on `pool` until its best fitness is at most `target` or
+// `keep_going(generation)` returns false. Transport is SharedMemoryTransport or SocketTransport.
+template<int N, class Transport, class KeepGoing>
+BasicPopulation<N> evolve_process_island(Transport& transport, ThreadPool& pool, unsigned int island, unsigned int island_count,
+                                         MigrationTopology topology, double target, KeepGoing&& keep_going,
+                                         size_t& generations, size_t& immigrations) {
+    BasicPopulation<N> population(initializeGenes<N>());
+    MigrantRecord record;
+    vector<BasicGene<N>> migrants(MIGRANT_COUNT, BasicGene<N>(UNINITIALIZED_GENE));
+    generations = 0;
+    immigrations = 0;
+    while (population.best().fitness > target && keep_going(generations)) {
+        population.evolve(pool);
+        ++generations;
+        if (island_count < 2 || generations % MIGRATION_INTERVAL != 0) continue;
+
+        unsigned int peer = ALL_ISLANDS;
+        if (topology == MigrationTopology::Ring) peer = (island + 1) % island_count;
+        if (topology == MigrationTopology::Random) peer = randomMigrationTarget(island, island_count);
+        packMigrants(population, island, peer, record);
+        transport.send(record);
+
+        for (unsigned int from = 0; from < island_count; ++from) {
+            if (from == island || !transport.receive(from, record)) continue;
+            if (!unpackMigrants(record, migrants.data())) continue;
+            population.immigrate(migrants.data(), MIGRANT_COUNT);
+            ++immigrations;
+        }
+    }
+    return population;
+}
+
+#endif // defined(__unix__) || defined(__APPLE__)
+
+#endif // ISLANDTRANSPORT_H
@@ -0,0 +1,157 @@
+#ifndef ISLANDS_H
+#define ISLANDS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <tools/evolution.h>
+#include <tools/ThreadPool.h>
+
+// Single-producer single-consumer handoff of the latest value. The producer never waits for the
+// consumer and the consumer only ever sees whole values: three slots rotate between being written,
+// being the last one published and being read, and only the index of the middle one is shared.
+template<class T>
+class TripleBuffer {
+public:
+    T& writeBuffer() { return slots[back]; }
+
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // The newest published value, or nullptr if nothing was published since the last call
+    const T* read() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return nullptr;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return &slots[front];
+    }
+
+private:
+    static constexpr uint8_t INDEX = 3, FRESH = 4;
+
+    array<T, 3> slots;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint8_t> middle{1};
+    alignas(CACHE_LINE_SIZE) uint8_t back = 0; // Producer's
+    alignas(CACHE_LINE_SIZE) uint8_t front = 2; // Consumer's
+};
+
+// Whether `from` sends its migrants to `to`; with the random topology it sends only to the one
+// island randomMigrationTarget() picked for this migration
+inline bool islandSendsTo(MigrationTopology topology, unsigned int from, unsigned int to, unsigned int island_count) {
+    if (from == to) return false;
+    return topology != MigrationTopology::Ring || to == (from + 1) % island_count;
+}
+
+inline unsigned int randomMigrationTarget(unsigned int from, unsigned int island_count) {
+    return (from + random_integer(1, island_count - 1)) % island_count;
+}
+
+struct Migrants {
+    array<Gene, MIGRANT_COUNT> genes;
+};
+
+// What an island shows the outside world after each generation
+struct IslandReport {
+    Gene best{UNINITIALIZED_GENE};
+    double average_fitness = 0.0;
+    size_t generation = 0;
+};
+
+// One population per thread, each evolved with the ordinary single-population operators. Islands never
+// wait for each other: every MIGRATION_INTERVAL generations an island publishes its elites into the
+// mailboxes of its neighbours and takes in whatever its own mailboxes hold, if anything.
+class IslandModel {
+public:
+    IslandModel(unsigned int island_count, MigrationTopology topology)
+        : island_count(std::max(1u, island_count)), topology(topology),
+          mailboxes(this->island_count * this->island_count), reports(this->island_count) {
+        for (auto& mailbox : mailboxes) mailbox = std::make_unique<TripleBuffer<Migrants>>();
+        for (auto& report : reports) report = std::make_unique<TripleBuffer<IslandReport>>();
+        latest.resize(this->island_count);
+    }
+
+    ~IslandModel() { stop(); }
+
+    void start() {
+        running = true;
+        for (unsigned int island = 0; island < island_count; ++island) {
+            threads.emplace_back([this, island]() { evolveIsland(island); });
+        }
+    }
+
+    void stop() {
+        running = false;
+        for (auto& thread : threads) thread.join();
+        threads.clear();
+    }
+
+    unsigned int size() const { return island_count; }
+
+    // Best gene over all islands, the mean of their average fitness and the total generation count,
+    // as of each island's last report. Call from one thread only.
+    bool snapshot(Gene& best, double& average_fitness, size_t& generations) {
+        bool any = false;
+        average_fitness = 0.0;
+        generations = 0;
+        for (unsigned int island = 0; island < island_count; ++island) {
+            if (const IslandReport* report = reports[island]->read()) latest[island] = *report;
+            if (latest[island].generation == 0) continue;
+            if (!any || latest[island].best.fitness < best.fitness) best = latest[island].best;
+            average_fitness += latest[island].average_fitness / island_count;
+            generations += latest[island].generation;
+            any = true;
+        }
+        return any;
+    }
+
+private:
+    TripleBuffer<Migrants>& mailbox(unsigned int from, unsigned int to) { return *mailboxes[from * island_count + to]; }
+
+    bool sendsTo(unsigned int from, unsigned int to) const {
+        return islandSendsTo(topology, from, to, island_count);
+    }
+
+    void evolveIsland(unsigned int island) {
+        Population population(initializeGenes());
+        ThreadPool pool(1); // Runs inline: the island is the unit of parallelism
+        for (size_t generation = 1; running.load(std::memory_order_relaxed); ++generation) {
+            population.evolve(pool);
+
+            if (island_count > 1 && generation % MIGRATION_INTERVAL == 0) {
+                unsigned int random_target = randomMigrationTarget(island, island_count);
+                for (unsigned int to = 0; to < island_count; ++to) {
+                    if (!sendsTo(island, to)) continue;
+                    if (topology == MigrationTopology::Random && to != random_target) continue;
+                    Migrants& outgoing = mailbox(island, to).writeBuffer();
+                    for (int m = 0; m < MIGRANT_COUNT; ++m) outgoing.genes[m] = population.genes[population.ranking[m]];
+                    mailbox(island, to).publish();
+                }
+                for (unsigned int from = 0; from < island_count; ++from) {
+                    if (!sendsTo(from, island)) continue;
+                    if (const Migrants* incoming = mailbox(from, island).read()) {
+                        population.immigrate(incoming->genes.data(), MIGRANT_COUNT);
+                    }
+                }
+            }
+
+            IslandReport& report = reports[island]->writeBuffer();
+            report.best = population.best();
+            report.average_fitness = population.averageFitness();
+            report.generation = generation;
+            reports[island]->publish();
+        }
+    }
+
+    const unsigned int island_count;
+    const MigrationTopology topology;
+    vector<std::unique_ptr<TripleBuffer<Migrants>>> mailboxes; // [from * island_count + to]
+    vector<std::unique_ptr<TripleBuffer<IslandReport>>> reports;
+    vector<IslandReport> latest;
+    vector<std::thread> threads;
+    std::atomic<bool> running{false};
+};
+
+#endif // ISLANDS_H
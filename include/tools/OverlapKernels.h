@@ -0,0 +1,126 @@
+#ifndef OVERLAPKERNELS_H
+#define OVERLAPKERNELS_H
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tools/customRand.h>
+#include <tools/Square.h>
+#include <tools/SimdOverlap.h>
+
+// A pair overlap kernel that can be picked at runtime. Kernels flagged `simd` are scored in whole rows
+// through simd_overlap_kernel where a gene allows it; `pair` is the same formula for a single pair.
+struct OverlapKernel {
+    const char* name;
+    number (*pair)(const Square&, const Square&, CullingStats&);
+    bool simd;
+};
+
+number referencePairOverlap(const Square& sq1, const Square& sq2, CullingStats&) {
+    return areaOfSquareIntersections(sq1, sq2);
+}
+number clippingPairOverlap(const Square& sq1, const Square& sq2, CullingStats&) {
+    return clippedAreaOfSquareIntersections(sq1, sq2);
+}
+number simdPairOverlap(const Square& sq1, const Square& sq2, CullingStats&) {
+    return pairOverlapLanes<number>(sq1.c.x, sq1.c.y, sq1.cos_t, sq1.sin_t, sq1.l / 2,
+                                    sq2.c.x, sq2.c.y, sq2.cos_t, sq2.sin_t, sq2.l / 2);
+}
+
+inline const OverlapKernel overlap_kernels[] = {
+    { "reference", referencePairOverlap, false }, // Intersection points + angular sort
+    { "clipping", clippingPairOverlap, false },   // Sutherland-Hodgman, stack only
+    { "culled", overlapAreaOfSquares, false },    // Broadphase rejection, then clipping
+    { "simd", simdPairOverlap, true },            // Closed form, vectorised over pairs
+};
+
+const OverlapKernel* findOverlapKernel(const char* name) {
+    for (const OverlapKernel& kernel : overlap_kernels) {
+        if (strcmp(kernel.name, name) == 0) return &kernel;
+    }
+    return nullptr;
+}
+
+// Fitness evaluation reads this on every call; only change it before the workers start.
+// Bounded evaluation scores pairs one at a time, closest first, so there are no full SIMD rows to win with.
+inline const OverlapKernel* active_overlap_kernel = &overlap_kernels[2];
+
+// Differential check: a sampled fraction of evaluations is re-scored with a second kernel
+// and the largest disagreement on the total overlap is kept
+struct OverlapKernelCheck {
+    double rate = 0.0; // Fraction of evaluations checked; 0 turns the check off
+    const OverlapKernel* against = &overlap_kernels[0];
+    std::atomic<unsigned long long> checks{0};
+    std::atomic<double> max_difference{0.0};
+
+    bool sample() const {
+        return rate > 0.0 && random_real(0, 1) < rate;
+    }
+
+    template<class Squares>
+    void compare(const Squares& squares, size_t count, double overlap) {
+        CullingStats unused;
+        double expected = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t j = i + 1; j < count; ++j) {
+                expected += against->pair(squares[i], squares[j], unused);
+            }
+        }
+        const double difference = fabs(expected - overlap);
+        double seen = max_difference.load(std::memory_order_relaxed);
+        while (difference > seen && !max_difference.compare_exchange_weak(seen, difference, std::memory_order_relaxed)) {}
+        checks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void report() const {
+        if (checks == 0) return;
+        printf("Kernel check (%s vs %s) over %llu evaluations: largest overlap difference %g\n",
+               active_overlap_kernel->name, against->name, checks.load(), max_difference.load());
+    }
+};
+
+inline OverlapKernelCheck overlap_kernel_check;
+
+// Fuzz over nearly coincident pairs, where rounding is at its worst: the second square is the first
+// one moved and turned by 10^-2 to 10^-8 (and by a random quarter turn, which maps a square onto itself).
+// Every kernel is scored against the closed-form one; worst[k] is overlap_kernels[k]'s largest error.
+template<size_t KERNELS>
+void fuzzOverlapKernels(size_t pairs, std::array<double, KERNELS>& worst) {
+    static_assert(KERNELS == std::size(overlap_kernels));
+    const OverlapKernel& truth = *findOverlapKernel("simd");
+    CullingStats unused;
+    worst.fill(0.0);
+    for (size_t p = 0; p < pairs; ++p) {
+        const Square a(Point(random_real(0, 5), random_real(0, 5)), random_real(0, 2 * M_PI), 1);
+        const double scale = pow(10.0, -random_real(2, 8));
+        const Square b(Point(a.c.x + random_real(-scale, scale), a.c.y + random_real(-scale, scale)),
+                       a.t + random_integer(0, 3) * M_PI / 2 + random_real(-scale, scale), 1);
+        const double expected = truth.pair(a, b, unused);
+        for (size_t k = 0; k < KERNELS; ++k) {
+            worst[k] = max(worst[k], fabs(overlap_kernels[k].pair(a, b, unused) - expected));
+        }
+    }
+}
+
+// OVERLAP_KERNEL picks the kernel, OVERLAP_CHECK_RATE and OVERLAP_CHECK_KERNEL configure the check
+void configureOverlapKernelsFromEnvironment() {
+    if (const char* name = getenv("OVERLAP_KERNEL")) {
+        const OverlapKernel* kernel = findOverlapKernel(name);
+        if (!kernel) throw std::invalid_argument(std::string("Unknown overlap kernel: ") + name);
+        active_overlap_kernel = kernel;
+    }
+    if (const char* rate = getenv("OVERLAP_CHECK_RATE")) {
+        overlap_kernel_check.rate = atof(rate);
+    }
+    if (const char* name = getenv("OVERLAP_CHECK_KERNEL")) {
+        const OverlapKernel* kernel = findOverlapKernel(name);
+        if (!kernel) throw std::invalid_argument(std::string("Unknown overlap kernel: ") + name);
+        overlap_kernel_check.against = kernel;
+    }
+}
+
+#endif // OVERLAPKERNELS_H
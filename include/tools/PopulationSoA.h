@@ -0,0 +1,103 @@
+#ifndef POPULATIONSOA_H
+#define POPULATIONSOA_H
+
+#include <vector>
+#include <tools/Square.h>
+#include <tools/SimdOverlap.h>
+
+// Squares of many individuals laid out square-major: entry [i * stride + k] holds square i of
+// individual k. Lane k of a SIMD register is then individual k, so one pass over the pairs (i, j)
+// scores a whole block of individuals with the same instructions and contiguous loads.
+class PopulationSoA {
+public:
+    static constexpr size_t BLOCK = SIMD_LANES; // Individuals scored per kernel call
+
+    size_t squares = 0;
+    size_t individuals = 0;
+    size_t stride = 0; // individuals rounded up to BLOCK
+    vector<number> x, y, cos_t, sin_t, half_l;
+
+    // squareOf(k, i) returns square i of individual k. Storage is reused between calls.
+    template<typename SquareOf>
+    void load(size_t individual_count, size_t square_count, SquareOf&& squareOf) {
+        individuals = individual_count;
+        squares = square_count;
+        stride = (individuals + BLOCK - 1) / BLOCK * BLOCK;
+        const size_t size = squares * stride;
+        x.resize(size); y.resize(size); cos_t.resize(size); sin_t.resize(size); half_l.resize(size);
+        for (size_t i = 0; i < squares; ++i) {
+            for (size_t k = 0; k < stride; ++k) {
+                const size_t at = i * stride + k;
+                if (k >= individuals) { // Padding lanes hold empty squares
+                    x[at] = y[at] = sin_t[at] = half_l[at] = 0.0;
+                    cos_t[at] = 1.0;
+                    continue;
+                }
+                const Square& sq = squareOf(k, i);
+                x[at] = sq.c.x;
+                y[at] = sq.c.y;
+                cos_t[at] = sq.cos_t;
+                sin_t[at] = sq.sin_t;
+                half_l[at] = sq.l / 2.0;
+            }
+        }
+    }
+};
+
+// Overlap of every pair (i < j) for the individuals [first, first + BLOCK).
+// out[p * BLOCK + lane] receives pair p, numbered in the same i-major order as Gene::pairIndex.
+template<class V> __attribute__((always_inline)) inline void populationPairsLanes(const PopulationSoA& pop, size_t first, number* out) {
+    constexpr size_t W = sizeof(V) / sizeof(number);
+    const size_t stride = pop.stride;
+    for (size_t lane = 0; lane < PopulationSoA::BLOCK; lane += W) {
+        const size_t k = first + lane;
+        size_t p = 0;
+        for (size_t i = 0; i < pop.squares; ++i) {
+            const size_t a = i * stride + k;
+            const V xi = loadLanes<V>(&pop.x[a]), yi = loadLanes<V>(&pop.y[a]);
+            const V ci = loadLanes<V>(&pop.cos_t[a]), si = loadLanes<V>(&pop.sin_t[a]);
+            const V hi = loadLanes<V>(&pop.half_l[a]);
+            for (size_t j = i + 1; j < pop.squares; ++j, ++p) {
+                const size_t b = j * stride + k;
+                storeLanes<V>(out + p * PopulationSoA::BLOCK + lane, pairOverlapLanes<V>(xi, yi, ci, si, hi,
+                    loadLanes<V>(&pop.x[b]), loadLanes<V>(&pop.y[b]), loadLanes<V>(&pop.cos_t[b]), loadLanes<V>(&pop.sin_t[b]), loadLanes<V>(&pop.half_l[b])));
+            }
+        }
+    }
+}
+
+typedef void (*PopulationPairsFunction)(const PopulationSoA&, size_t, number*);
+
+void populationPairsScalar(const PopulationSoA& pop, size_t first, number* out) {
+    populationPairsLanes<number>(pop, first, out);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Compiled for the instruction set of its callers, like the helpers in SimdOverlap.h
+#pragma GCC push_options
+#pragma GCC target("sse2")
+template void populationPairsLanes<number4>(const PopulationSoA&, size_t, number*);
+#pragma GCC target("avx2")
+template void populationPairsLanes<number8>(const PopulationSoA&, size_t, number*);
+#pragma GCC pop_options
+
+__attribute__((target("sse2"))) void populationPairsSSE(const PopulationSoA& pop, size_t first, number* out) {
+    populationPairsLanes<number4>(pop, first, out);
+}
+__attribute__((target("avx2"))) void populationPairsAVX2(const PopulationSoA& pop, size_t first, number* out) {
+    populationPairsLanes<number8>(pop, first, out);
+}
+#endif
+
+PopulationPairsFunction selectPopulationPairs() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return populationPairsAVX2;
+    if (__builtin_cpu_supports("sse2")) return populationPairsSSE;
+#endif
+    return populationPairsScalar;
+}
+
+inline const PopulationPairsFunction population_pairs_kernel = selectPopulationPairs();
+
+#endif // POPULATIONSOA_H
@@ -0,0 +1,57 @@
+#ifndef RUNOPTIONS_H
+#define RUNOPTIONS_H
+
+// Command-line options shared by the headless front ends (apps/solver.cpp, apps/islandWorker.cpp):
+// the instance, the stopping rules and the GA settings. GA settings go straight into ga_parameters.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <tools/evolution.h>
+
+struct RunOptions {
+    int n = GENE_SIZE;
+    size_t generation_limit = 0;
+    double second_limit = 0.0;
+    uint64_t seed = std::random_device{}();
+    unsigned int thread_count = 1;
+    double target = 0.0;
+};
+
+// Applies `option` if it is one of the shared options; false for any other option
+inline bool parseRunOption(const std::string& option, const char* value, RunOptions& options) {
+    if (option == "--n") options.n = atoi(value);
+    else if (option == "--l") ga_parameters.box_side_length = atof(value);
+    else if (option == "--generations") options.generation_limit = strtoull(value, nullptr, 10);
+    else if (option == "--seconds") options.second_limit = atof(value);
+    else if (option == "--seed") options.seed = strtoull(value, nullptr, 10);
+    else if (option == "--threads") options.thread_count = std::max(1, atoi(value));
+    else if (option == "--target") options.target = atof(value);
+    else if (option == "--population") ga_parameters.population_size = atoi(value);
+    else if (option == "--mutation-rate") ga_parameters.mutation_rate = atof(value);
+    else if (option == "--elitism-rate") ga_parameters.elitism_rate = atof(value);
+    else if (option == "--predation-rate") ga_parameters.predation_rate = atof(value);
+    else if (option == "--tournament-size") ga_parameters.tournament_size = atoi(value);
+    else return false;
+    return true;
+}
+
+// Reports the first invalid setting on stderr; false if there is one
+inline bool checkRunOptions(const RunOptions& options) {
+    auto is_rate = [](double rate) { return rate >= 0.0 && rate <= 1.0; };
+    if (!is_rate(ga_parameters.mutation_rate) || !is_rate(ga_parameters.elitism_rate) || !is_rate(ga_parameters.predation_rate)) {
+        fprintf(stderr, "Mutation, elitism and predation rates must be between 0 and 1\n");
+        return false;
+    }
+    if (options.n < 2 || ga_parameters.box_side_length <= 0 || ga_parameters.population_size < 2 || ga_parameters.tournament_size < 1
+        || ga_parameters.eliteCount() > ga_parameters.population_size || ga_parameters.offspringCount() >= ga_parameters.population_size) {
+        fprintf(stderr, "Invalid problem size or GA rates: every generation must keep at least one survivor\n");
+        return false;
+    }
+    return true;
+}
+
+#endif // RUNOPTIONS_H
@@ -0,0 +1,313 @@
+#ifndef SIMDOVERLAP_H
+#define SIMDOVERLAP_H
+
+#include <cstring>
+#include <vector>
+#include <tools/MathArray.h>
+#include <tools/Square.h>
+
+// Branch-free overlap kernel that computes one square against many at once.
+//
+// Clamping each coordinate to [-h, h] is the nearest-point projection onto an axis-aligned square B.
+// Projecting the boundary of A onto B gives a closed curve whose enclosed area is exactly area(A∩B):
+// the parts of A's edges inside B stay in place and the parts outside slide along B's border.
+// The shoelace integral of x dy - y dx along a clamped edge has a closed form, so every lane
+// runs the same instructions whatever the configuration, and the result is continuous in the
+// input, so touching or coincident edges need no special handling.
+
+constexpr size_t SIMD_LANES = 8; // Widest lane count (AVX2); the SoA views are padded to it
+
+// Structure-of-arrays view of a set of squares. After the `size` real squares the arrays wrap
+// around (entry n holds square n % size), so a block starting anywhere below `count` can be loaded
+// in one go, including the shifted blocks used by the all-pairs sum.
+struct SquareLanes {
+    const number* x;
+    const number* y;
+    const number* cos_t;
+    const number* sin_t;
+    const number* half_l;
+    size_t size;  // Number of squares
+    size_t count; // size rounded up to a multiple of SIMD_LANES
+};
+
+template<size_t N>
+struct SquaresSoA {
+    static constexpr size_t PADDED_SIZE = (N + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES;
+    static constexpr size_t STORAGE_SIZE = PADDED_SIZE + N / 2 + SIMD_LANES;
+    alignas(32) number x[STORAGE_SIZE];
+    alignas(32) number y[STORAGE_SIZE];
+    alignas(32) number cos_t[STORAGE_SIZE];
+    alignas(32) number sin_t[STORAGE_SIZE];
+    alignas(32) number half_l[STORAGE_SIZE];
+
+    SquaresSoA() = default;
+    explicit SquaresSoA(const MathArray<Square, N>& squares) { load(squares); }
+
+    void load(const MathArray<Square, N>& squares) {
+        for (size_t i = 0; i < N; ++i) {
+            set(i, squares[i]);
+        }
+        wrap();
+    }
+    void set(size_t i, const Square& sq) {
+        x[i] = sq.c.x;
+        y[i] = sq.c.y;
+        cos_t[i] = sq.cos_t;
+        sin_t[i] = sq.sin_t;
+        half_l[i] = sq.l / 2.0;
+    }
+    void wrap() {
+        for (size_t i = N; i < STORAGE_SIZE; ++i) {
+            x[i] = x[i % N];
+            y[i] = y[i % N];
+            cos_t[i] = cos_t[i % N];
+            sin_t[i] = sin_t[i % N];
+            half_l[i] = half_l[i % N];
+        }
+    }
+    SquareLanes lanes() const {
+        return { x, y, cos_t, sin_t, half_l, N, PADDED_SIZE };
+    }
+};
+
+// SquaresSoA for a number of squares only known at runtime. Storage is reused between loads.
+struct DynamicSquaresSoA {
+    vector<number> x, y, cos_t, sin_t, half_l;
+    size_t size = 0;
+    size_t padded_size = 0;
+
+    template<typename Squares>
+    void load(const Squares& squares) {
+        size = squares.size();
+        padded_size = (size + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES;
+        const size_t storage_size = padded_size + size / 2 + SIMD_LANES;
+        x.resize(storage_size); y.resize(storage_size); cos_t.resize(storage_size); sin_t.resize(storage_size); half_l.resize(storage_size);
+        for (size_t i = 0; i < storage_size; ++i) {
+            const Square& sq = squares[i % size];
+            x[i] = sq.c.x;
+            y[i] = sq.c.y;
+            cos_t[i] = sq.cos_t;
+            sin_t[i] = sq.sin_t;
+            half_l[i] = sq.l / 2.0;
+        }
+    }
+    SquareLanes lanes() const {
+        return { x.data(), y.data(), cos_t.data(), sin_t.data(), half_l.data(), size, padded_size };
+    }
+};
+
+// --- Lane-generic kernel ---
+// V is either `number` or a GCC vector of numbers; the same source serves the scalar, SSE and AVX2 paths.
+
+template<class V> __attribute__((always_inline)) inline V broadcast(number v) {
+    return V{} + v;
+}
+template<class V> __attribute__((always_inline)) inline V loadLanes(const number* p) {
+    V v;
+    memcpy(&v, p, sizeof(V));
+    return v;
+}
+template<class V> __attribute__((always_inline)) inline void storeLanes(number* p, const V& v) {
+    memcpy(p, &v, sizeof(V));
+}
+
+template<class V> __attribute__((always_inline)) inline V one_over(const V& v) {
+    return broadcast<V>(1.0) / v;
+}
+template<class V> __attribute__((always_inline)) inline V clampLanes(const V& u, const V& h) {
+    V low = broadcast<V>(0.0) - h;
+    return u < low ? low : (u > h ? h : u);
+}
+template<class V> __attribute__((always_inline)) inline V absLanes(const V& u) {
+    return u < broadcast<V>(0.0) ? -u : u;
+}
+
+// Parameter range [t0, t1] (unbounded) where |a + t*d| <= h, given inverse_d = 1/d
+template<class V> __attribute__((always_inline)) inline void slabRange(const V& a, const V& inverse_d, const V& h, V& t0, V& t1) {
+    const V ta = (broadcast<V>(0.0) - h - a) * inverse_d, tb = (h - a) * inverse_d;
+    t0 = ta < tb ? ta : tb;
+    t1 = ta < tb ? tb : ta;
+}
+
+// Integral of x dv along the clamped image of the segment (a + t*d, t in [0,1]), where v is the
+// other coordinate. v only moves while it is inside [-h, h], so the integral is dv times the
+// integral of clamp(x) over that stretch of t, which splits into the part where x is inside
+// [-h, h] (linear) and the parts where it is pinned to -h or h (constant).
+template<class V> __attribute__((always_inline)) inline V clampedIntegral(const V& ax, const V& av, const V& dx, const V& dv, const V& inverse_dx, const V& inverse_dv, const V& h) {
+    const V zero = broadcast<V>(0.0), tiny = broadcast<V>(1e-20);
+    V s0, s1, r0, r1;
+    slabRange<V>(av, inverse_dv, h, s0, s1);
+    slabRange<V>(ax, inverse_dx, h, r0, r1);
+    s0 = s0 > zero ? s0 : zero;
+    s1 = s1 < broadcast<V>(1.0) ? s1 : broadcast<V>(1.0);
+    s1 = s1 > s0 ? s1 : s0;
+
+    V m0 = s0 > r0 ? s0 : r0, m1 = s1 < r1 ? s1 : r1;
+    m1 = m1 > m0 ? m1 : m0;
+    const V inside = (m1 - m0) * (ax + dx * (m0 + m1) * broadcast<V>(0.5));
+    V before = (s1 < r0 ? s1 : r0) - s0, after = s1 - (s0 > r1 ? s0 : r1);
+    before = before > zero ? before : zero;
+    after = after > zero ? after : zero;
+    const V pinned = dx > zero ? h * (after - before) : h * (before - after);
+
+    // When x doesn't move the slab of x is unbounded (or NaN) and clamp(ax) is used directly
+    const V x_integral = absLanes<V>(dx) < tiny ? (s1 - s0) * clampLanes<V>(ax, h) : inside + pinned;
+    return absLanes<V>(dv) < tiny ? zero : dv * x_integral;
+}
+
+// Overlap area of squares i and j in every lane
+template<class V> __attribute__((always_inline)) inline V pairOverlapLanes(const V& xi, const V& yi, const V& ci, const V& si, const V& hi,
+                                                                  const V& xj, const V& yj, const V& cj, const V& sj, const V& hj) {
+    const V zero = broadcast<V>(0.0), two = broadcast<V>(2.0);
+    const V gx = xj - xi, gy = yj - yi;
+    // Square j expressed in the frame of square i, where i is the box [-hi, hi]^2
+    const V px = gx * ci + gy * si;
+    const V py = gy * ci - gx * si;
+    const V rc = cj * ci + sj * si;
+    const V rs = sj * ci - cj * si;
+    const V ux = hj * rc, uy = hj * rs; // j's local x half-axis; the y half-axis is (-uy, ux)
+
+    // Edges of j, counter-clockwise: +2u, +2v, -2u, -2v with v = (-uy, ux)
+    const V bx[4] = { px - ux + uy, px + ux + uy, px + ux - uy, px - ux - uy };
+    const V by[4] = { py - uy - ux, py + uy - ux, py + uy + ux, py - uy + ux };
+    const V ex[4] = { two * ux, zero - two * uy, zero - two * ux, two * uy };
+    const V ey[4] = { two * uy, two * ux, zero - two * uy, zero - two * ux };
+    const V inverse_x = one_over<V>(two * ux), inverse_y = one_over<V>(two * uy);
+    const V inverse_ex[4] = { inverse_x, zero - inverse_y, zero - inverse_x, inverse_y };
+    const V inverse_ey[4] = { inverse_y, inverse_x, zero - inverse_y, zero - inverse_x };
+
+    V twice_area = zero;
+    for (int k = 0; k < 4; ++k) {
+        twice_area += clampedIntegral<V>(bx[k], by[k], ex[k], ey[k], inverse_ex[k], inverse_ey[k], hi)
+                    - clampedIntegral<V>(by[k], bx[k], ey[k], ex[k], inverse_ey[k], inverse_ex[k], hi);
+    }
+    twice_area = twice_area > zero ? twice_area : zero; // Rounding can leave touching squares slightly negative
+    return twice_area * broadcast<V>(0.5);
+}
+
+template<class V> __attribute__((always_inline)) inline V pairOverlapLanes(const SquareLanes& lanes, size_t i, size_t j) {
+    return pairOverlapLanes<V>(
+        loadLanes<V>(lanes.x + i), loadLanes<V>(lanes.y + i), loadLanes<V>(lanes.cos_t + i), loadLanes<V>(lanes.sin_t + i), loadLanes<V>(lanes.half_l + i),
+        loadLanes<V>(lanes.x + j), loadLanes<V>(lanes.y + j), loadLanes<V>(lanes.cos_t + j), loadLanes<V>(lanes.sin_t + j), loadLanes<V>(lanes.half_l + j));
+}
+
+// Overlap area of square i against the squares [begin, lanes.count), written to out[begin..count).
+// `begin` must be a multiple of the lane width of V; entries from lanes.size on are wrapped copies.
+template<class V> __attribute__((always_inline)) inline void overlapRowLanes(const SquareLanes& lanes, size_t i, size_t begin, number* out) {
+    constexpr size_t W = sizeof(V) / sizeof(number);
+    const V xi = broadcast<V>(lanes.x[i]), yi = broadcast<V>(lanes.y[i]);
+    const V ci = broadcast<V>(lanes.cos_t[i]), si = broadcast<V>(lanes.sin_t[i]);
+    const V hi = broadcast<V>(lanes.half_l[i]);
+    for (size_t j = begin; j < lanes.count; j += W) {
+        storeLanes<V>(out + j, pairOverlapLanes<V>(xi, yi, ci, si, hi,
+            loadLanes<V>(lanes.x + j), loadLanes<V>(lanes.y + j), loadLanes<V>(lanes.cos_t + j), loadLanes<V>(lanes.sin_t + j), loadLanes<V>(lanes.half_l + j)));
+    }
+    if (i >= begin) out[i] = 0.0;
+}
+
+// Sum over all pairs. Pairing square j with square j + k (mod size) for k = 1..size/2 visits every
+// pair once (the k = size/2 diagonal only for the first half when size is even), so all lanes do
+// useful work instead of the shrinking triangle of i < j.
+template<class V> __attribute__((always_inline)) inline number totalOverlapLanes(const SquareLanes& lanes) {
+    constexpr size_t W = sizeof(V) / sizeof(number);
+    number lane_offsets[W];
+    for (size_t w = 0; w < W; ++w) lane_offsets[w] = w;
+    const V offsets = loadLanes<V>(lane_offsets);
+    V total = broadcast<V>(0.0);
+    for (size_t k = 1; k <= lanes.size / 2; ++k) {
+        const number limit = (2 * k == lanes.size) ? k : lanes.size;
+        for (size_t j = 0; j < limit; j += W) {
+            const V area = pairOverlapLanes<V>(lanes, j, j + k);
+            total += (broadcast<V>(j) + offsets < broadcast<V>(limit)) ? area : broadcast<V>(0.0);
+        }
+    }
+    number sums[W];
+    storeLanes<V>(sums, total);
+    number sum = 0.0;
+    for (size_t w = 0; w < W; ++w) sum += sums[w];
+    return sum;
+}
+
+// --- Runtime dispatch ---
+
+typedef void (*OverlapRowFunction)(const SquareLanes&, size_t, size_t, number*);
+typedef number (*TotalOverlapFunction)(const SquareLanes&);
+
+void overlapRowScalar(const SquareLanes& lanes, size_t i, size_t begin, number* out) {
+    overlapRowLanes<number>(lanes, i, begin, out);
+}
+number totalOverlapScalar(const SquareLanes& lanes) {
+    return totalOverlapLanes<number>(lanes);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+typedef number number4 __attribute__((vector_size(4 * sizeof(number))));
+typedef number number8 __attribute__((vector_size(8 * sizeof(number))));
+
+// The vector instantiations of the helpers are compiled for the instruction set of the functions that
+// use them. Compiled for the baseline instead, they would return vectors through an ABI that differs
+// with and without SSE/AVX, which GCC warns about (-Wpsabi) in every including file.
+#pragma GCC push_options
+#pragma GCC target("sse2")
+template number4 broadcast<number4>(number);
+template number4 loadLanes<number4>(const number*);
+template number4 one_over<number4>(const number4&);
+template number4 clampLanes<number4>(const number4&, const number4&);
+template number4 absLanes<number4>(const number4&);
+template number4 clampedIntegral<number4>(const number4&, const number4&, const number4&, const number4&, const number4&, const number4&, const number4&);
+template number4 pairOverlapLanes<number4>(const number4&, const number4&, const number4&, const number4&, const number4&,
+                                           const number4&, const number4&, const number4&, const number4&, const number4&);
+template number4 pairOverlapLanes<number4>(const SquareLanes&, size_t, size_t);
+template void storeLanes<number4>(number*, const number4&);
+template void slabRange<number4>(const number4&, const number4&, const number4&, number4&, number4&);
+template void overlapRowLanes<number4>(const SquareLanes&, size_t, size_t, number*);
+template number totalOverlapLanes<number4>(const SquareLanes&);
+#pragma GCC target("avx2")
+template number8 broadcast<number8>(number);
+template number8 loadLanes<number8>(const number*);
+template number8 one_over<number8>(const number8&);
+template number8 clampLanes<number8>(const number8&, const number8&);
+template number8 absLanes<number8>(const number8&);
+template number8 clampedIntegral<number8>(const number8&, const number8&, const number8&, const number8&, const number8&, const number8&, const number8&);
+template number8 pairOverlapLanes<number8>(const number8&, const number8&, const number8&, const number8&, const number8&,
+                                           const number8&, const number8&, const number8&, const number8&, const number8&);
+template number8 pairOverlapLanes<number8>(const SquareLanes&, size_t, size_t);
+template void storeLanes<number8>(number*, const number8&);
+template void slabRange<number8>(const number8&, const number8&, const number8&, number8&, number8&);
+template void overlapRowLanes<number8>(const SquareLanes&, size_t, size_t, number*);
+template number totalOverlapLanes<number8>(const SquareLanes&);
+#pragma GCC pop_options
+
+__attribute__((target("sse2"))) void overlapRowSSE(const SquareLanes& lanes, size_t i, size_t begin, number* out) {
+    overlapRowLanes<number4>(lanes, i, begin - begin % 4, out);
+}
+__attribute__((target("sse2"))) number totalOverlapSSE(const SquareLanes& lanes) {
+    return totalOverlapLanes<number4>(lanes);
+}
+__attribute__((target("avx2"))) void overlapRowAVX2(const SquareLanes& lanes, size_t i, size_t begin, number* out) {
+    overlapRowLanes<number8>(lanes, i, begin - begin % 8, out);
+}
+__attribute__((target("avx2"))) number totalOverlapAVX2(const SquareLanes& lanes) {
+    return totalOverlapLanes<number8>(lanes);
+}
+#endif
+
+struct OverlapKernelSIMD {
+    OverlapRowFunction row;
+    TotalOverlapFunction total;
+    const char* name;
+};
+
+// Picks the widest instruction set the running CPU supports, so one binary runs everywhere
+OverlapKernelSIMD selectOverlapKernelSIMD() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return { overlapRowAVX2, totalOverlapAVX2, "avx2" };
+    if (__builtin_cpu_supports("sse2")) return { overlapRowSSE, totalOverlapSSE, "sse2" };
+#endif
+    return { overlapRowScalar, totalOverlapScalar, "scalar" };
+}
+
+inline const OverlapKernelSIMD simd_overlap_kernel = selectOverlapKernelSIMD();
+
+#endif // SIMDOVERLAP_H
@@ -0,0 +1,80 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <tools/Square.h>
+
+// Uniform grid over the container, used as a broadphase when there are too many squares for the
+// all-pairs loop. With cells at least as wide as a square's diagonal, two squares can only overlap
+// if their centers fall in the same or in adjacent cells.
+class SpatialHash {
+public:
+    // Buckets every square by the cell of its center. Centers outside the box are clamped to the
+    // border cells, which keeps neighbouring squares in neighbouring cells.
+    template<typename Squares>
+    void build(const Squares& squares, size_t count, number box_side, number cell_size) {
+        this->cell_size = cell_size;
+        cells_per_side = max(1, (int)ceil(box_side / cell_size));
+        const size_t cell_count = (size_t)cells_per_side * cells_per_side;
+
+        cell_start.assign(cell_count + 1, 0);
+        cell_of.resize(count);
+        items.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            cell_of[i] = cellIndex(squares[i].c);
+            ++cell_start[cell_of[i] + 1];
+        }
+        for (size_t c = 0; c < cell_count; ++c) {
+            cell_start[c + 1] += cell_start[c];
+        }
+        fill.assign(cell_start.begin(), cell_start.end() - 1);
+        for (size_t i = 0; i < count; ++i) {
+            items[fill[cell_of[i]]++] = (int)i;
+        }
+    }
+
+    // Calls f(i, j) once for every pair of squares in the same or in adjacent cells
+    template<typename F>
+    void forEachCandidatePair(F&& f) const {
+        // Half of the 8-neighbourhood, so each pair of cells is visited once
+        static const int forward[4][2] = { {1, 0}, {-1, 1}, {0, 1}, {1, 1} };
+        for (int cy = 0; cy < cells_per_side; ++cy) {
+            for (int cx = 0; cx < cells_per_side; ++cx) {
+                const int cell = cy * cells_per_side + cx;
+                for (int a = cell_start[cell]; a < cell_start[cell + 1]; ++a) {
+                    for (int b = a + 1; b < cell_start[cell + 1]; ++b) {
+                        f(items[a], items[b]);
+                    }
+                }
+                for (const auto& offset : forward) {
+                    const int nx = cx + offset[0], ny = cy + offset[1];
+                    if (nx < 0 || nx >= cells_per_side || ny >= cells_per_side) continue;
+                    const int neighbour = ny * cells_per_side + nx;
+                    for (int a = cell_start[cell]; a < cell_start[cell + 1]; ++a) {
+                        for (int b = cell_start[neighbour]; b < cell_start[neighbour + 1]; ++b) {
+                            f(items[a], items[b]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    number cell_size = 1.0;
+    int cells_per_side = 1;
+    vector<int> cell_start; // items[cell_start[c] .. cell_start[c+1]) are the squares in cell c
+    vector<int> items;
+    vector<int> cell_of;
+    vector<int> fill;
+
+    int cellIndex(const Point& p) const {
+        int cx = min(cells_per_side - 1, max(0, (int)floor(p.x / cell_size)));
+        int cy = min(cells_per_side - 1, max(0, (int)floor(p.y / cell_size)));
+        return cy * cells_per_side + cx;
+    }
+};
+
+#endif // SPATIALHASH_H
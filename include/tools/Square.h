@@ -1,8 +1,16 @@
+#ifndef SQUARE_H
+#define SQUARE_H
+
 #include <vector>
+#include <array>
 #include <cmath>
 #include <algorithm>
 #include <numeric>
 #include <set>
+#include <atomic>
+#include <limits>
+#include <cstdio>
+#include <tools/Counters.h>
 
 using namespace std;
 
@@ -54,63 +62,64 @@ public:
     Point c; // centro (x,y)
     number t; // inclinação (teta)
     number l = 1.0; // l (lado do quadrado)
+    // Derived from c, t and l. Call refresh() after changing any of them.
+    number cos_t = 1.0, sin_t = 0.0; // direção unitária de t
+    array<Point, 4> corners; // vértices em sentido anti-horário
     Square(Point c,number t,number l){
         this->c = c;
         this->t = t;
         this->l = l;
+        refresh();
     }
     Square() = default;
 
-    vector<Point> getVertices() const { 
+    void refresh() {
+        cos_t = cos(t);
+        sin_t = sin(t);
         number half_l = l / 2.0;
-        vector<Point> corners = {
-            Point(-half_l, -half_l),
-            Point( half_l, -half_l),
-            Point( half_l,  half_l),
-            Point(-half_l,  half_l)
+        number dx = half_l * cos_t, dy = half_l * sin_t;
+        corners = {
+            Point(c.x - dx + dy, c.y - dy - dx),
+            Point(c.x + dx + dy, c.y + dy - dx),
+            Point(c.x + dx - dy, c.y + dy + dx),
+            Point(c.x - dx - dy, c.y - dy + dx)
         };
-        vector<Point> vertices(4);
-        size_t i = 0;
-        for (const auto& corner : corners) {
-            number x_rot = value(corner.x * cos(t) - corner.y * sin(t));
-            number y_rot = value(corner.x * sin(t) + corner.y * cos(t));
-            vertices[i++] = (Point(c.x + x_rot, c.y + y_rot));
-        }
-        return vertices;
+    }
+
+    vector<Point> getVertices() const { 
+        return vector<Point>(corners.begin(), corners.end());
+    }
+
+    // Same as getVertices(), without the heap allocation
+    const array<Point, 4>& getCorners() const {
+        return corners;
     }
 };
 
+// Corners of nearly coincident squares lie on each other's edges up to float rounding, far more than
+// EPSILON, so points within 1e-5 of the side length count as inside
 bool pointInSquare(const Point& p, const Square& sq) {
     number dx = p.x - sq.c.x;
     number dy = p.y - sq.c.y;
-    number cos_t = cos(-sq.t);
-    number sin_t = sin(-sq.t);
-    number local_x = dx * cos_t - dy * sin_t;
-    number local_y = dx * sin_t + dy * cos_t;
-    number half_l = sq.l / 2.0;
-    return (abs(local_x) <= half_l + EPSILON) && (abs(local_y) <= half_l + EPSILON);
+    number local_x = dx * sq.cos_t + dy * sq.sin_t;
+    number local_y = dy * sq.cos_t - dx * sq.sin_t;
+    number half_l = sq.l / 2.0 * (1 + 1e-5);
+    return (abs(local_x) <= half_l) && (abs(local_y) <= half_l);
 }
 
+// Solved in double: edges of nearly coincident squares are nearly parallel, and in float the
+// crossing point of two such lines can land well off both of them.
 bool segmentIntersect(const Point& p1, const Point& p2, const Point& q1, const Point& q2, Point& intersection) {
-    number A1 = p2.y - p1.y;
-    number B1 = p1.x - p2.x;
-    number C1 = A1 * p1.x + B1 * p1.y;
-    number A2 = q2.y - q1.y;
-    number B2 = q1.x - q2.x;
-    number C2 = A2 * q1.x + B2 * q1.y;
-    number det = A1 * B2 - A2 * B1;
-    if (fabs(det) < EPSILON) return false; 
-    number x = (B2 * C1 - B1 * C2) / det;
-    number y = (A1 * C2 - A2 * C1) / det;
-    auto between = [](number a, number b, number c) {
-        return min(a, b) - EPSILON <= c && c <= max(a, b) + EPSILON;
-    };
-    if (between(p1.x, p2.x, x) && between(p1.y, p2.y, y) &&
-        between(q1.x, q2.x, x) && between(q1.y, q2.y, y)) {
-        intersection = Point(x, y);
-        return true;
-    }
-    return false;
+    const double dpx = double(p2.x) - p1.x, dpy = double(p2.y) - p1.y;
+    const double dqx = double(q2.x) - q1.x, dqy = double(q2.y) - q1.y;
+    const double det = dpx * dqy - dpy * dqx;
+    if (det == 0.0) return false;
+    const double rx = double(q1.x) - p1.x, ry = double(q1.y) - p1.y;
+    const double t = (rx * dqy - ry * dqx) / det; // Along p1->p2
+    const double u = (rx * dpy - ry * dpx) / det; // Along q1->q2
+    if (t < 0.0 || t > 1.0 || u < 0.0 || u > 1.0) return false;
+    intersection = Point(p1.x + t * dpx, p1.y + t * dpy);
+    return true;
 }
 
 vector<Point> getSquareIntersections(const Square& sq1, const Square& sq2) {
@@ -155,8 +164,7 @@ number areaOfPolygon(vector<Point>& pts){ // Fórmula do cadarço
 }
 
 bool squareContainedIn(const Square& inner, const Square& outer) {
-    auto vertices = inner.getVertices();
-    for (const auto& v : vertices) {
+    for (const auto& v : inner.getCorners()) {
         if (!pointInSquare(v, outer)) return false;
     }
     return true;
@@ -185,3 +193,186 @@ number areaOfSquareIntersections(const Square& sq1, const Square& sq2) {
 
     return areaOfPolygon(vertices);
 }
+
+
+// A square clipped by the four half-planes of another square has at most 8 vertices. Rounding can
+// still add more for nearly coincident squares, whose vertices flip back and forth across an edge, so
+// points within CLIP_TOLERANCE (relative to the edge length) of an edge count as on it. The buffers
+// still fit the worst case: a clip keeps the i points inside and adds one per crossing of the edge,
+// at most 2 * min(i, n - i) of them, so 4 vertices can grow to 6, 9, 13 and then 19.
+constexpr size_t clippedVertexBound(size_t n) {
+    size_t bound = n;
+    for (size_t i = 0; i <= n; ++i) bound = max(bound, i + 2 * min(i, n - i));
+    return bound;
+}
+typedef array<Point, clippedVertexBound(clippedVertexBound(clippedVertexBound(clippedVertexBound(4))))> ClipPolygon;
+constexpr number CLIP_TOLERANCE = 1e-5;
+
+// Sutherland-Hodgman step: keeps the part of `in` on the left of the directed edge a->b
+size_t clipPolygonByEdge(const ClipPolygon& in, size_t n, const Point& a, const Point& b, ClipPolygon& out) {
+    const Point edge = b - a;
+    const number tolerance = CLIP_TOLERANCE * (edge.x * edge.x + edge.y * edge.y);
+    auto side = [&](const Point& p) {
+        const number cross = edge.x * (p.y - a.y) - edge.y * (p.x - a.x);
+        return fabs(cross) < tolerance ? 0 : cross;
+    };
+    size_t m = 0;
+    Point prev = in[n - 1];
+    number prev_side = side(prev);
+    for (size_t i = 0; i < n; ++i) {
+        const Point& cur = in[i];
+        number cur_side = side(cur);
+        if ((cur_side >= 0) != (prev_side >= 0)) {
+            number k = prev_side / (prev_side - cur_side);
+            out[m++] = prev + (cur - prev) * k;
+        }
+        if (cur_side >= 0) {
+            out[m++] = cur;
+        }
+        prev = cur;
+        prev_side = cur_side;
+    }
+    return m;
+}
+
+// Drop-in replacement for areaOfSquareIntersections that only uses stack memory:
+// sq1 is clipped by the edges of sq2 and the result is measured with the shoelace formula.
+number clippedAreaOfSquareIntersections(const Square& sq1, const Square& sq2) {
+    const array<Point, 4>& clip = sq2.getCorners();
+    const array<Point, 4>& subject = sq1.getCorners();
+
+    ClipPolygon buffers[2];
+    copy(subject.begin(), subject.end(), buffers[0].begin());
+    size_t n = 4;
+    int current = 0;
+    for (size_t e = 0; e < 4 && n > 0; ++e) {
+        n = clipPolygonByEdge(buffers[current], n, clip[e], clip[(e + 1) % 4], buffers[1 - current]);
+        current = 1 - current;
+    }
+    if (n < 3) return 0.0;
+
+    const ClipPolygon& poly = buffers[current];
+    const Point origin = poly[0];
+    number sum = 0.0;
+    for (size_t i = 1; i + 1 < n; ++i) {
+        Point a = poly[i] - origin;
+        Point b = poly[i + 1] - origin;
+        sum += a.x * b.y - b.x * a.y;
+    }
+    return value(fabs(sum / 2.0));
+}
+
+// --- Broadphase ---
+// Cheap rejection tests, from loosest to tightest. Each one returning false means the squares can't overlap.
+
+bool boundingCirclesOverlap(const Square& sq1, const Square& sq2) {
+    number dx = sq2.c.x - sq1.c.x;
+    number dy = sq2.c.y - sq1.c.y;
+    number reach = (sq1.l + sq2.l) * (number)M_SQRT1_2; // Sum of the circumradii
+    return dx * dx + dy * dy < reach * reach;
+}
+
+bool boundingBoxesOverlap(const Square& sq1, const Square& sq2) {
+    auto half_extent = [](const Square& sq) {
+        return (fabs(sq.cos_t) + fabs(sq.sin_t)) * sq.l / 2.0;
+    };
+    number reach = half_extent(sq1) + half_extent(sq2);
+    return fabs(sq2.c.x - sq1.c.x) < reach && fabs(sq2.c.y - sq1.c.y) < reach;
+}
+
+// Separating axis theorem: for two squares the only candidate axes are their own edge normals
+bool separatingAxisExists(const Square& sq1, const Square& sq2) {
+    const number cos1 = sq1.cos_t, sin1 = sq1.sin_t;
+    const number cos2 = sq2.cos_t, sin2 = sq2.sin_t;
+    const Point axes[4] = { Point(cos1, sin1), Point(-sin1, cos1), Point(cos2, sin2), Point(-sin2, cos2) };
+    const Point d = sq2.c - sq1.c;
+    for (const Point& u : axes) {
+        number r1 = (fabs(u.x * cos1 + u.y * sin1) + fabs(u.y * cos1 - u.x * sin1)) * sq1.l / 2.0;
+        number r2 = (fabs(u.x * cos2 + u.y * sin2) + fabs(u.y * cos2 - u.x * sin2)) * sq2.l / 2.0;
+        if (fabs(u.x * d.x + u.y * d.y) >= r1 + r2) return true;
+    }
+    return false;
+}
+
+// Smallest projected overlap over the same four axes: how far the squares would have to move
+// apart to stop touching. Zero when an axis separates them. No polygon is built.
+number penetrationDepthOfSquares(const Square& sq1, const Square& sq2) {
+    if (!boundingCirclesOverlap(sq1, sq2)) return 0.0;
+    const number cos1 = sq1.cos_t, sin1 = sq1.sin_t;
+    const number cos2 = sq2.cos_t, sin2 = sq2.sin_t;
+    const Point axes[4] = { Point(cos1, sin1), Point(-sin1, cos1), Point(cos2, sin2), Point(-sin2, cos2) };
+    const Point d = sq2.c - sq1.c;
+    number depth = std::numeric_limits<number>::max();
+    for (const Point& u : axes) {
+        number r1 = (fabs(u.x * cos1 + u.y * sin1) + fabs(u.y * cos1 - u.x * sin1)) * sq1.l / 2.0;
+        number r2 = (fabs(u.x * cos2 + u.y * sin2) + fabs(u.y * cos2 - u.x * sin2)) * sq2.l / 2.0;
+        number overlap = r1 + r2 - fabs(u.x * d.x + u.y * d.y);
+        if (overlap <= 0) return 0.0;
+        depth = min(depth, overlap);
+    }
+    return depth;
+}
+
+// How many square pairs each broadphase stage rejected
+struct CullingStats {
+    unsigned long long pairs = 0;
+    unsigned long long circle_rejected = 0;
+    unsigned long long aabb_rejected = 0;
+    unsigned long long sat_rejected = 0;
+
+    unsigned long long exact() const {
+        return pairs - circle_rejected - aabb_rejected - sat_rejected;
+    }
+};
+
+// Process-wide totals. Evaluators count locally and merge once per call into their own thread's
+// counters, which are only summed for a snapshot, so workers never write to a shared cache line.
+struct CullingCounters {
+    void merge(const CullingStats& stats) {
+        if (stats.pairs == 0) return;
+        Counts& counts = threads.local();
+        counts.pairs.add(stats.pairs);
+        counts.circle_rejected.add(stats.circle_rejected);
+        counts.aabb_rejected.add(stats.aabb_rejected);
+        counts.sat_rejected.add(stats.sat_rejected);
+    }
+    CullingStats snapshot() const {
+        CullingStats stats;
+        threads.forEach([&](const Counts& counts) {
+            stats.pairs += counts.pairs.load();
+            stats.circle_rejected += counts.circle_rejected.load();
+            stats.aabb_rejected += counts.aabb_rejected.load();
+            stats.sat_rejected += counts.sat_rejected.load();
+        });
+        return stats;
+    }
+    void report() const {
+        CullingStats stats = snapshot();
+        if (stats.pairs == 0) return;
+        auto percent = [&](unsigned long long n) { return 100.0 * n / stats.pairs; };
+        printf("Broadphase over %llu pairs:\n", stats.pairs);
+        printf("  bounding circle rejected %llu (%.1f%%)\n", stats.circle_rejected, percent(stats.circle_rejected));
+        printf("  bounding box rejected    %llu (%.1f%%)\n", stats.aabb_rejected, percent(stats.aabb_rejected));
+        printf("  separating axis rejected %llu (%.1f%%)\n", stats.sat_rejected, percent(stats.sat_rejected));
+        printf("  exact area computed      %llu (%.1f%%)\n", stats.exact(), percent(stats.exact()));
+    }
+
+private:
+    struct Counts {
+        SingleWriterCounter pairs, circle_rejected, aabb_rejected, sat_rejected;
+    };
+    PerThreadCounters<Counts> threads;
+};
+
+inline CullingCounters culling_counters;
+
+// Overlap area of two squares, running the exact kernel only on pairs that survive the broadphase
+number overlapAreaOfSquares(const Square& sq1, const Square& sq2, CullingStats& stats) {
+    ++stats.pairs;
+    if (!boundingCirclesOverlap(sq1, sq2)) { ++stats.circle_rejected; return 0.0; }
+    if (!boundingBoxesOverlap(sq1, sq2)) { ++stats.aabb_rejected; return 0.0; }
+    if (separatingAxisExists(sq1, sq2)) { ++stats.sat_rejected; return 0.0; }
+    return clippedAreaOfSquareIntersections(sq1, sq2);
+}
+
+#endif // SQUARE_H
@@ -0,0 +1,113 @@
+#ifndef STEADYSTATE_H
+#define STEADYSTATE_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <tools/evolution.h>
+#include <tools/ThreadPool.h>
+
+// Steady-state GA: there are no generations. Every worker loops on its own, picking parents by
+// tournament, breeding and scoring one child, and letting it replace the loser of an inverse
+// tournament if the child is better. Each slot has its own lock, held only to copy a gene in or out,
+// and tournaments read a packed array of atomic fitness values without locking at all. A slot is only
+// ever replaced by something better, so the best gene is never lost.
+class SteadyStateEngine {
+public:
+    SteadyStateEngine(vector<Gene> initial_population, unsigned int thread_count)
+        : thread_count(std::max(1u, thread_count)), slots(initial_population.size()), fitness(initial_population.size()) {
+        for (size_t k = 0; k < slots.size(); ++k) {
+            fitness[k].store(initial_population[k].fitness, std::memory_order_relaxed);
+            slots[k].gene = std::move(initial_population[k]);
+        }
+    }
+
+    ~SteadyStateEngine() { stop(); }
+
+    void start() {
+        running = true;
+        for (unsigned int worker = 0; worker < thread_count; ++worker) {
+            threads.emplace_back([this]() { breed(); });
+        }
+    }
+
+    void stop() {
+        running = false;
+        for (auto& thread : threads) thread.join();
+        threads.clear();
+    }
+
+
+    // Best gene, average fitness and births in generations' worth of children, at this moment
+    bool snapshot(Gene& best, double& average_fitness, size_t& generations) {
+        size_t best_slot = 0;
+        average_fitness = 0.0;
+        for (size_t k = 0; k < slots.size(); ++k) {
+            const double value = fitness[k].load(std::memory_order_relaxed);
+            average_fitness += value / slots.size();
+            if (value < fitness[best_slot].load(std::memory_order_relaxed)) best_slot = k;
+        }
+        std::lock_guard<SpinLock> guard(slots[best_slot].lock);
+        best = slots[best_slot].gene;
+        generations = births.load(std::memory_order_relaxed) / max(1, ga_parameters.offspringCount());
+        return true;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        SpinLock lock;
+        Gene gene{UNINITIALIZED_GENE}; // Filled from the initial population; the lock makes slots immovable
+    };
+
+    size_t tournament(bool pick_worst) const {
+        size_t chosen = random_integer(0, slots.size() - 1);
+        for (int i = 1; i < ga_parameters.tournament_size; ++i) {
+            size_t candidate = random_integer(0, slots.size() - 1);
+            const double a = fitness[candidate].load(std::memory_order_relaxed);
+            const double b = fitness[chosen].load(std::memory_order_relaxed);
+            if (pick_worst ? a > b : a < b) chosen = candidate;
+        }
+        return chosen;
+    }
+
+    void copyOut(size_t k, Gene& gene) {
+        std::lock_guard<SpinLock> guard(slots[k].lock);
+        gene = slots[k].gene;
+    }
+
+    void breed() {
+        Gene parent1(UNINITIALIZED_GENE), parent2(UNINITIALIZED_GENE), child(UNINITIALIZED_GENE);
+        while (running.load(std::memory_order_relaxed)) {
+            copyOut(tournament(false), parent1);
+            copyOut(tournament(false), parent2);
+            cross_into(parent1, parent2, child);
+            const bool disaster = random_real(0, 1) < ga_parameters.disaster_probability;
+            mutate_gene(child, disaster ? ga_parameters.disaster_hypermutation_rate : ga_parameters.mutation_rate);
+            births.fetch_add(1, std::memory_order_relaxed);
+
+            // A child is only worth its exact score if it beats the gene it would replace
+            const size_t victim = tournament(true);
+            const double victim_fitness = fitness[victim].load(std::memory_order_relaxed);
+            if constexpr (USE_BOUNDED_EVALUATION) {
+                if (!child.calculateFitnessBounded(victim_fitness)) continue;
+            } else {
+                child.calculateFitness();
+            }
+            if (child.fitness >= victim_fitness) continue;
+            std::lock_guard<SpinLock> guard(slots[victim].lock);
+            if (child.fitness >= slots[victim].gene.fitness) continue; // Replaced meanwhile by something better
+            slots[victim].gene = child;
+            fitness[victim].store(child.fitness, std::memory_order_relaxed);
+        }
+    }
+
+    const unsigned int thread_count;
+    vector<Slot> slots;
+    vector<std::atomic<double>> fitness; // Mirrors slots[k].gene.fitness for lock-free tournaments
+    vector<std::thread> threads;
+    std::atomic<size_t> births{0};
+    std::atomic<bool> running{false};
+};
+
+#endif // STEADYSTATE_H
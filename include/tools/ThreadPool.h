@@ -0,0 +1,206 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <tools/Counters.h>
+
+// Busy-wait step: a pause hint at first, then yielding, so that a spinning thread does not hold a
+// core that the thread it is waiting for needs (more workers than cores)
+inline void cpuRelax(int spin) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (spin < 64) {
+        __builtin_ia32_pause();
+        return;
+    }
+#endif
+    std::this_thread::yield();
+}
+
+// Test-and-test-and-set lock for critical sections a few hundred nanoseconds long
+class SpinLock {
+public:
+    void lock() {
+        for (int spin = 0; locked.exchange(true, std::memory_order_acquire); ++spin) {
+            while (locked.load(std::memory_order_relaxed)) cpuRelax(spin++);
+        }
+    }
+    void unlock() { locked.store(false, std::memory_order_release); }
+
+private:
+    std::atomic<bool> locked{false};
+};
+
+// Spins for a short while before blocking on the phase counter. Phases of a generation are
+// microseconds long, so a thread that arrives early usually sees the others within the spin
+// and never pays for a futex sleep and wake-up.
+class SpinBarrier {
+public:
+    static constexpr int SPIN_LIMIT = 1 << 10;
+
+    explicit SpinBarrier(unsigned int participants) : participants(participants) {}
+
+    void arriveAndWait() {
+        const unsigned int current = phase.load(std::memory_order_acquire);
+        if (waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == participants) {
+            waiting.store(0, std::memory_order_relaxed);
+            phase.store(current + 1, std::memory_order_release);
+            phase.notify_all();
+            return;
+        }
+        for (int spin = 0; spin < SPIN_LIMIT; ++spin) {
+            if (phase.load(std::memory_order_acquire) != current) return;
+            cpuRelax(spin);
+        }
+        while (phase.load(std::memory_order_acquire) == current) {
+            phase.wait(current, std::memory_order_acquire);
+        }
+    }
+
+private:
+    const unsigned int participants;
+    std::atomic<unsigned int> waiting{0};
+    std::atomic<unsigned int> phase{0};
+};
+
+// Work-stealing over the index range [0, count): every worker starts with its static share and
+// takes indices from the front of it; a worker that runs dry steals the back half of another's.
+// A share is packed as begin << 32 | end in one atomic, so both owner and thieves move it with a CAS.
+class StealingRanges {
+public:
+    explicit StealingRanges(unsigned int workers) : ranges(workers) {}
+
+    void distribute(size_t count) {
+        const size_t workers = ranges.size();
+        const size_t chunk_size = count / workers;
+        for (size_t worker = 0; worker < workers; ++worker) {
+            const size_t begin = worker * chunk_size;
+            const size_t end = (worker == workers - 1) ? count : begin + chunk_size;
+            ranges[worker].packed.store(pack(begin, end), std::memory_order_relaxed);
+        }
+    }
+
+    // Next index for `worker`, stealing if its own share is empty; false once every share is empty
+    bool next(unsigned int worker, size_t& index) {
+        if (take(ranges[worker].packed, index)) return true;
+        const size_t workers = ranges.size();
+        for (size_t offset = 1; offset < workers; ++offset) {
+            std::atomic<uint64_t>& victim = ranges[(worker + offset) % workers].packed;
+            uint64_t seen = victim.load(std::memory_order_relaxed);
+            while (begin(seen) < end(seen)) {
+                const uint32_t middle = begin(seen) + (end(seen) - begin(seen)) / 2;
+                if (victim.compare_exchange_weak(seen, pack(begin(seen), middle), std::memory_order_relaxed)) {
+                    // Our own share is empty, so no thief touches it until this store makes it non-empty
+                    index = middle;
+                    ranges[worker].packed.store(pack(middle + 1, end(seen)), std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Range { // One cache line each, so owners do not contend on neighbouring shares
+        std::atomic<uint64_t> packed{0};
+    };
+
+    static uint64_t pack(uint64_t begin, uint64_t end) { return begin << 32 | end; }
+    static uint32_t begin(uint64_t packed) { return packed >> 32; }
+    static uint32_t end(uint64_t packed) { return static_cast<uint32_t>(packed); }
+
+    static bool take(std::atomic<uint64_t>& range, size_t& index) {
+        uint64_t seen = range.load(std::memory_order_relaxed);
+        while (begin(seen) < end(seen)) {
+            if (range.compare_exchange_weak(seen, pack(begin(seen) + 1, end(seen)), std::memory_order_relaxed)) {
+                index = begin(seen);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Range> ranges;
+};
+
+// Long-lived workers that run one job at a time on every thread. The calling thread takes part as
+// worker 0, so a pool of size 1 starts no threads at all. Workers idle between jobs the same way the
+// barrier waits: spinning first, then blocking, so a paused evolution loop costs no CPU.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int thread_count) : thread_count(std::max(1u, thread_count)), phase_barrier(this->thread_count), task_ranges(this->thread_count) {
+        for (unsigned int worker = 1; worker < this->thread_count; ++worker) {
+            workers.emplace_back([this, worker]() { workerLoop(worker); });
+        }
+    }
+
+    ~ThreadPool() {
+        stopping.store(true, std::memory_order_relaxed);
+        job_generation.fetch_add(1, std::memory_order_release);
+        job_generation.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int size() const { return thread_count; }
+
+    // Runs job(worker) on every thread and returns once all of them have finished
+    template<class F>
+    void run(F&& job) {
+        job_context = const_cast<void*>(static_cast<const void*>(&job));
+        job_invoke = [](void* context, unsigned int worker) { (*static_cast<std::remove_reference_t<F>*>(context))(worker); };
+        job_generation.fetch_add(1, std::memory_order_release);
+        job_generation.notify_all();
+        job(0);
+        phase_barrier.arriveAndWait();
+    }
+
+    // Separates two phases inside a job; every worker must reach it the same number of times
+    void barrier() { phase_barrier.arriveAndWait(); }
+
+    // The [begin, end) share of `count` items for one worker; the last worker takes the remainder
+    std::pair<size_t, size_t> chunk(size_t count, unsigned int worker) const {
+        const size_t chunk_size = count / thread_count;
+        const size_t begin = worker * chunk_size;
+        return { begin, (worker == thread_count - 1) ? count : begin + chunk_size };
+    }
+
+    // Hands out [0, count) to the next job through nextTask(); call before run()
+    void distributeTasks(size_t count) { task_ranges.distribute(count); }
+    bool nextTask(unsigned int worker, size_t& index) { return task_ranges.next(worker, index); }
+
+private:
+    void workerLoop(unsigned int worker) {
+        unsigned int seen = 0;
+        while (true) {
+            for (int spin = 0; spin < SpinBarrier::SPIN_LIMIT && job_generation.load(std::memory_order_acquire) == seen; ++spin) {
+                cpuRelax(spin);
+            }
+            while (job_generation.load(std::memory_order_acquire) == seen) {
+                job_generation.wait(seen, std::memory_order_acquire);
+            }
+            seen = job_generation.load(std::memory_order_acquire);
+            if (stopping.load(std::memory_order_relaxed)) return;
+            job_invoke(job_context, worker);
+            phase_barrier.arriveAndWait();
+        }
+    }
+
+    const unsigned int thread_count;
+    SpinBarrier phase_barrier;
+    StealingRanges task_ranges;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned int> job_generation{0};
+    std::atomic<bool> stopping{false};
+    void* job_context = nullptr;
+    void (*job_invoke)(void*, unsigned int) = nullptr;
+};
+
+#endif // THREADPOOL_H
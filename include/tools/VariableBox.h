@@ -0,0 +1,188 @@
+#ifndef VARIABLEBOX_H
+#define VARIABLEBOX_H
+
+#include <tools/evolution.h>
+#include <tools/ThreadPool.h>
+
+// Adaptive penalty weights, after Hadj-Alouane and Bean: every PENALTY_ADAPTATION_INTERVAL generations
+// the overlap and out-of-bounds weights grow if the best gene was infeasible throughout, so the search
+// is pulled back to valid packings, and shrink if it was feasible throughout, so that smaller boxes
+// become worth a little overlap on the way to fixing it. Overlap of tilted squares grows with the
+// square of their penetration, so at any weight the best gene sits a hair past feasible: it counts
+// as feasible here within FEASIBILITY_TOLERANCE. The weights only turn around after
+// PENALTY_REVERSAL_INTERVALS intervals in a row ask for it, so they settle instead of flipping back
+// and forth every interval.
+class PenaltyAdaptation {
+public:
+    // Call once per generation; returns true when the weights in ga_parameters changed, which leaves
+    // every score computed so far out of date
+    bool observe(bool best_feasible) {
+        ++observed;
+        feasible += best_feasible;
+        if (observed < PENALTY_ADAPTATION_INTERVAL) return false;
+
+        const int wanted = feasible == observed ? -1 : feasible == 0 ? 1 : 0;
+        observed = feasible = 0;
+        if (wanted == 0) {
+            reversal_votes = 0;
+            return false;
+        }
+        if (wanted == -direction && ++reversal_votes < PENALTY_REVERSAL_INTERVALS) return false;
+        reversal_votes = 0;
+        direction = wanted;
+
+        // Both weights move together, so their ratio stays as configured
+        const double low = min(ga_parameters.overlap_weight, ga_parameters.out_of_bounds_weight);
+        const double high = max(ga_parameters.overlap_weight, ga_parameters.out_of_bounds_weight);
+        double factor = wanted > 0 ? PENALTY_INCREASE_FACTOR : 1.0 / PENALTY_DECREASE_FACTOR;
+        factor = std::clamp(factor, MIN_PENALTY_WEIGHT / low, MAX_PENALTY_WEIGHT / high);
+        if (factor == 1.0) return false;
+
+        ga_parameters.overlap_weight *= factor;
+        ga_parameters.out_of_bounds_weight *= factor;
+        ++changes;
+        return true;
+    }
+
+    size_t changes = 0;
+
+private:
+    int observed = 0;
+    int feasible = 0;
+    int direction = 0; // Of the last change: 1 up, -1 down
+    int reversal_votes = 0; // Intervals in a row that asked to go against `direction`
+};
+
+// Makes a nearly feasible gene exactly feasible: the box grows by FEASIBILITY_REPAIR_STEP at a time,
+// spreading the squares with it, and squares sticking out are pushed back in. Returns false, with the
+// gene in its last state, if that takes more than FEASIBILITY_REPAIR_STEPS steps.
+template<int N>
+bool repair_to_feasible(BasicGene<N>& gene) {
+    for (int step = 0; step <= FEASIBILITY_REPAIR_STEPS; ++step) {
+        if (step > 0) {
+            const number side = gene.box_side * (1 + FEASIBILITY_REPAIR_STEP);
+            rescale_squares(gene, gene.box_side, side);
+            gene.setBoxSide(side);
+        }
+        for (size_t i = 0; i < gene.size(); ++i) {
+            Square& sq = gene.data[i];
+            const number reach = (fabs(sq.cos_t) + fabs(sq.sin_t)) * sq.l / 2.0;
+            const Point inside(std::clamp(sq.c.x, reach, max(reach, gene.box_side - reach)),
+                               std::clamp(sq.c.y, reach, max(reach, gene.box_side - reach)));
+            if (inside.x == sq.c.x && inside.y == sq.c.y) continue;
+            sq.c = inside;
+            sq.refresh();
+            gene.markChanged(i);
+        }
+        gene.calculateFitness();
+        if (gene.isFeasible()) return true;
+    }
+    return false;
+}
+
+template<int N>
+struct VariableBoxResult {
+    bool found = false;
+    BasicGene<N> best{UNINITIALIZED_GENE}; // Feasible gene with the smallest box seen, if found
+    size_t generations = 0;
+    size_t weight_changes = 0;
+};
+
+// Evolves the box side along with the squares until keep_going(generations) is false. Fitness is the
+// box side plus the weighted penalties, and the weights adapt as above; ga_parameters is left with the
+// final weights. The population starts at ga_parameters.box_side_length (the grid side ceil(sqrt(N)) is
+// always feasible), except for a BOX_SIDE_SEED_RATE share of random genes spread over the smaller
+// boxes down to the area bound sqrt(N), so that the search does not only see packings derived from
+// the grid; after BOX_SIDE_RESEED_INTERVAL generations without a smaller feasible box, the same share
+// of genes, the worst non-elites by packed fitness, is drawn again below the smallest feasible box
+// found. A box mutation changes the side by up to BOX_SIDE_MARGIN_STEP of the feasibility margin, the
+// room left between the smallest feasible box found and the area bound, so the steps are large while
+// that room is and get finer as it closes.
+//
+// The elites are checked for feasible packings every generation, since once the weights drop an
+// infeasible gene in a smaller box can outrank them: the one in the smallest box that is feasible
+// within FEASIBILITY_TOLERANCE is repaired, and kept if it still beats the best. Low weights can also
+// let every feasible gene die out, leaving nothing to compare the infeasible ones against, so at the
+// end of every adaptation interval with an infeasible best gene the best feasible packing replaces
+// the worst gene.
+template<int N, class KeepGoing>
+VariableBoxResult<N> evolve_variable_box(ThreadPool& pool, KeepGoing&& keep_going) {
+    const bool was_variable = ga_parameters.variable_box;
+    const double initial_step = ga_parameters.box_side_step;
+    ga_parameters.variable_box = true;
+
+    VariableBoxResult<N> result;
+    vector<BasicGene<N>> genes = initializeGenes<N>();
+    const number start_side = ga_parameters.box_side_length;
+    const number area_side = SQUARE_SIDE_LENGTH * sqrt(genes.front().size());
+    auto scale_box_step = [&](number feasible_side) {
+        ga_parameters.box_side_step = max(BOX_SIDE_MUTATION_STEP, BOX_SIDE_MARGIN_STEP * (feasible_side - area_side) / feasible_side);
+    };
+    scale_box_step(start_side);
+    auto seed_below = [&](BasicGene<N>& gene, number top) {
+        gene = BasicGene<N>(); // Random squares in the starting box
+        const number side = random_real(area_side, top);
+        rescale_squares(gene, start_side, side);
+        gene.setBoxSide(side);
+        gene.calculateFitness();
+    };
+    const size_t seeded = min<size_t>(genes.size() - 1, BOX_SIDE_SEED_RATE * genes.size());
+    for (size_t k = 1; k <= seeded; ++k) seed_below(genes[k], start_side); // genes[0] is the grid
+    BasicPopulation<N> population(std::move(genes));
+    PenaltyAdaptation adaptation;
+    size_t last_improvement = 0;
+    auto record_feasible = [&]() {
+        const size_t elite_count = min<size_t>(max(ga_parameters.eliteCount(), 1), population.genes.size());
+        const BasicGene<N>* candidate = nullptr;
+        for (size_t r = 0; r < elite_count; ++r) {
+            const BasicGene<N>& gene = population.genes[population.ranking[r]];
+            if (result.found && gene.box_side >= result.best.box_side) continue;
+            if (candidate && gene.box_side >= candidate->box_side) continue;
+            if (gene.isFeasible(FEASIBILITY_TOLERANCE)) candidate = &gene;
+        }
+        if (!candidate) return;
+        BasicGene<N> repaired = *candidate;
+        if (repair_to_feasible(repaired) && (!result.found || repaired.box_side < result.best.box_side)) {
+            result.best = repaired;
+            result.found = true;
+            scale_box_step(repaired.box_side);
+            last_improvement = result.generations;
+        }
+    };
+
+    record_feasible();
+    while (keep_going(result.generations)) {
+        population.evolve(pool);
+        ++result.generations;
+        record_feasible();
+        if (adaptation.observe(population.best().isFeasible(FEASIBILITY_TOLERANCE))) population.rescore(pool);
+        if (result.generations - last_improvement >= BOX_SIDE_RESEED_INTERVAL) {
+            // rank() only orders the elites, so put the worst non-elites at the end of the ranking first
+            const size_t count = population.genes.size();
+            const size_t elite_count = min<size_t>(max(ga_parameters.eliteCount(), 1), count);
+            const size_t reseeded = min(seeded, count - elite_count);
+            vector<int>& ranking = population.ranking;
+            std::nth_element(ranking.begin() + elite_count, ranking.end() - reseeded, ranking.end(),
+                             [&](int a, int b) { return population.fitness[a] < population.fitness[b]; });
+            for (size_t r = count - reseeded; r < count; ++r) {
+                seed_below(population.genes[ranking[r]], result.found ? result.best.box_side : start_side);
+            }
+            population.rank();
+            last_improvement = result.generations;
+        }
+        if (result.found && result.generations % PENALTY_ADAPTATION_INTERVAL == 0
+            && !population.best().isFeasible(FEASIBILITY_TOLERANCE)) {
+            BasicGene<N> anchor = result.best;
+            anchor.dirty = true; // Scored under earlier weights
+            anchor.calculateFitness();
+            population.immigrate(&anchor, 1);
+        }
+    }
+    result.weight_changes = adaptation.changes;
+
+    ga_parameters.variable_box = was_variable;
+    ga_parameters.box_side_step = initial_step;
+    return result;
+}
+
+#endif // VARIABLEBOX_H
@@ -6,14 +6,22 @@
 #include <tools/customRand.h>
 #include <tools/MathArray.h>
 #include <tools/Square.h>
+#include <tools/SimdOverlap.h>
+#include <tools/OverlapKernels.h>
+#include <tools/SpatialHash.h>
+#include <tools/ContainerBounds.h>
+#include <tools/FitnessCache.h>
+#include <tools/PopulationSoA.h>
+#include <tools/ThreadPool.h>
 #include <utility>
 #include <algorithm>
 #include <limits>
 #include <cmath>
 #include <thread>
-#include <mutex>
 #include <stdexcept>
 #include <random> 
+#include <array>
+#include <bitset>
 
 using std::vector;
 using std::sort;
@@ -25,6 +33,8 @@ using std::round;
 typedef float number;
 
 // --- GA Configuration ---
+// Defaults: GENE_SIZE is the N that Gene, the visualizer and the island workers are built for, and
+// the rest seed ga_parameters, which holds the values the GA actually reads at runtime
 constexpr int GENE_SIZE = 17; // N: Number of squares to pack
 constexpr number SQUARE_SIDE_LENGTH = 1.0; // Side length of small squares
 constexpr number BOX_SIDE_LENGTH = 5;   // L: Side length of the container
@@ -43,117 +53,791 @@ constexpr double BOUNDARY_PENALTY_WEIGHT = 0.5; // How much to penalize non-alig
 constexpr double OUT_OF_BOUNDS_WEIGHT = 300; // How much to penalize for squares out of bounds
 constexpr double OVERLAP_WEIGHT = 5; // How much to penalize for squares overlapping
 
+constexpr int SPATIAL_HASH_THRESHOLD = 64; // Above this many squares, pairs come from a uniform grid instead of all-pairs
+constexpr number SPATIAL_HASH_CELL_SIZE = SQUARE_SIDE_LENGTH * M_SQRT2; // A square's diagonal
+// Cache pair terms and only re-score what changed (compiled sizes up to SPATIAL_HASH_THRESHOLD). Off: uniform
+// crossover leaves half the pairs of a child stale, bounded evaluation only scores the pairs that can overlap
+// anyway, and copying the O(N^2) cache into every child made a run 1.6-2.1x slower for N = 10 to 37.
+constexpr bool USE_DELTA_EVALUATION = false;
+constexpr bool USE_FITNESS_CACHE = true; // Remember recent exact scores by content hash, so a repeated gene is not scored again
+constexpr size_t FITNESS_CACHE_SLOTS = 256; // Per thread; a power of two
+// Stop scoring a child once it is certain to rank behind every exactly scored survivor. Such a child only
+// has a lower bound on its score, and selection puts it behind every exactly scored gene (see
+// BasicPopulation::packFitness), which is where it belongs: it can still be a parent, but only when a
+// tournament draws nothing but unfinished genes.
+constexpr bool USE_BOUNDED_EVALUATION = true;
+constexpr bool USE_POPULATION_SOA = false; // Score whole blocks of individuals at once, one per SIMD lane
+constexpr bool USE_SURROGATE_FITNESS = false; // Rank by penetration depth first, exact area only for the front-runners
+constexpr double SURROGATE_EXACT_RATE = 0.3; // Fraction of the surrogate-scored genes (best first) re-scored exactly
+constexpr double SURROGATE_AUDIT_PROBABILITY = 0.05; // Chance per generation to score everyone exactly and compare rankings
 
+constexpr bool USE_STEADY_STATE = false; // Workers breed and replace one gene at a time, with no generations
+
+enum class MigrationTopology { Ring, Random, FullyConnected };
+constexpr bool USE_ISLANDS = false; // One independent population per core instead of one shared population
+constexpr MigrationTopology MIGRATION_TOPOLOGY = MigrationTopology::Ring; // Where each island sends its elites
+constexpr int MIGRATION_INTERVAL = 50; // Generations between migrations
+constexpr int MIGRANT_COUNT = 2; // Elites sent per migration; they replace the receiver's worst genes
+
+constexpr bool USE_VARIABLE_BOX = false; // Evolve L with the squares; fitness is L plus the weighted penalties
+constexpr double BOX_SIDE_MUTATION_PROBABILITY = 0.2; // Chance per child to rescale its box, squares and all
+constexpr double BOX_SIDE_MUTATION_STEP = 0.02; // Largest relative change of L per mutation, at least
+constexpr double BOX_SIDE_MARGIN_STEP = 0.25; // Or this share of the feasibility margin, if larger (see VariableBox.h)
+constexpr double BOX_SIDE_SEED_RATE = 0.3; // Share of the population started, and restarted, in smaller boxes
+constexpr int BOX_SIDE_RESEED_INTERVAL = 5000; // Generations without a smaller feasible box before that share restarts
+constexpr int PENALTY_ADAPTATION_INTERVAL = 20; // Generations between adjustments of the penalty weights
+constexpr double PENALTY_INCREASE_FACTOR = 1.3; // Applied when the best gene was infeasible all interval long
+constexpr double PENALTY_DECREASE_FACTOR = 1.5; // Divides them when it was feasible all interval long; larger, so they don't cycle
+constexpr int PENALTY_REVERSAL_INTERVALS = 3; // Intervals in a row that must agree before the weights change direction
+constexpr double FEASIBILITY_TOLERANCE = 1e-4; // Unweighted overlap plus area outside the box that still counts as feasible
+constexpr double FEASIBILITY_REPAIR_STEP = 1e-3; // Relative growth of L per step when repairing a nearly feasible gene
+constexpr int FEASIBILITY_REPAIR_STEPS = 20; // Steps before the repair gives up
+constexpr double MIN_PENALTY_WEIGHT = 0.1;
+constexpr double MAX_PENALTY_WEIGHT = 1e5;
+
+constexpr int DYNAMIC_GENE_SIZE = 0; // BasicGene<DYNAMIC_GENE_SIZE> takes its size from ga_parameters.gene_size
+
+// Gene sizes with a fixed-size engine compiled into with_gene_size(); other sizes run on the dynamic one
+template<int... Sizes> struct GeneSizeList {};
+using SpecializedGeneSizes = GeneSizeList<5, 10, 11, 17, 18, 19, 26, 27, 37, 50>;
+
+// Problem and GA settings read at runtime. Workers read these on every generation; only change them
+// between runs, while no pool job or engine thread is running.
+struct GAParameters {
+    int gene_size = GENE_SIZE; // Only read by the dynamic-size engine
+    number box_side_length = BOX_SIDE_LENGTH;
+    int population_size = POPULATION_SIZE;
+    double elitism_rate = ELITISM_RATE;
+    double mutation_rate = MUTATION_RATE;
+    int tournament_size = TOURNAMENT_SIZE;
+    double rotational_snap_probability = ROTATIONAL_SNAP_PROBABILITY;
+    double predation_rate = PREDATION_RATE;
+    double disaster_probability = DISASTER_PROBABILITY;
+    double disaster_hypermutation_rate = DISASTER_HYPERMUTATION_RATE;
+    double out_of_bounds_weight = OUT_OF_BOUNDS_WEIGHT;
+    double overlap_weight = OVERLAP_WEIGHT;
+    bool variable_box = USE_VARIABLE_BOX; // Each gene's own box_side, starting at box_side_length, replaces it
+    double box_side_step = BOX_SIDE_MUTATION_STEP; // Largest relative change of box_side per box mutation
+
+    int eliteCount() const { return static_cast<int>(population_size * elitism_rate); }
+
+    // Children bred per generation: everyone but the elites and the non-elites that escape predation
+    int offspringCount() const {
+        const int non_elites = population_size - eliteCount();
+        return static_cast<int>(non_elites * predation_rate);
+    }
+
+    double fitness(double overlap_penalty, double bounds_penalty) const {
+        return (overlap_penalty * overlap_weight) + bounds_penalty * out_of_bounds_weight;
+    }
+};
+
+inline GAParameters ga_parameters;
+
+inline thread_local FitnessCache<FITNESS_CACHE_SLOTS> fitness_cache;
 
 extern thread_local xso::rng gen;
 
-class Gene { // Gene is a set of squares
+// Tag for constructing a Gene whose squares are about to be overwritten, skipping the random draws.
+// The squares are zeroed instead, since such genes may still be copied before they are overwritten.
+struct UninitializedGene {};
+inline constexpr UninitializedGene UNINITIALIZED_GENE{};
+
+// Population slots are written concurrently (children bred in place, fitness stored by whichever worker
+// scored them), so every Gene starts on its own cache line and never shares one with its neighbours.
+// N is the number of squares: fixed sizes get fully unrolled loops and the delta cache, while
+// DYNAMIC_GENE_SIZE keeps its squares in a vector sized from ga_parameters.gene_size.
+template<int N>
+class alignas(CACHE_LINE_SIZE) BasicGene { // Gene is a set of squares
 public:
-    MathArray<Square, GENE_SIZE> data;
+    static constexpr bool DYNAMIC = N == DYNAMIC_GENE_SIZE;
+    static constexpr bool DELTA = USE_DELTA_EVALUATION && !DYNAMIC && N <= SPATIAL_HASH_THRESHOLD;
+    static constexpr size_t CACHED_PAIRS = DELTA ? N * (N - 1) / 2 : 0;
+    static constexpr size_t CACHED_SQUARES = DELTA ? N : 0;
+    using Squares = std::conditional_t<DYNAMIC, vector<Square>, MathArray<Square, DYNAMIC ? 1 : N>>;
+    using SoA = std::conditional_t<DYNAMIC, DynamicSquaresSoA, SquaresSoA<DYNAMIC ? 1 : N>>;
+
+    Squares data;
     double fitness;
+    bool dirty = true; // fitness is not the exact score of data: data changed, or scoring gave up on it
+    double surrogate = 0.0; // Estimate of fitness that ranks a dirty gene in surrogate mode; see calculateSurrogateFitness()
+    number box_side; // The gene's container in variable-box mode; see boxSide()
 
-    Gene() : fitness(std::numeric_limits<double>::max()) {
-        for (size_t i = 0; i < GENE_SIZE; ++i) {
+    // Delta evaluation cache: the overlap of every pair and the bounds term of every square, as of
+    // the last calculateFitness(). Anything that edits data must mark what it touched as stale.
+    array<number, CACHED_PAIRS> pair_overlap{};
+    array<number, CACHED_SQUARES> bounds_term{};
+    bitset<CACHED_SQUARES> stale_squares; // All pairs and the bounds term of these squares
+    bitset<CACHED_PAIRS> stale_pairs;
+    bool stale_bounds = false; // Every bounds term, after a change of box_side
+
+    BasicGene() : fitness(std::numeric_limits<double>::max()), box_side(ga_parameters.box_side_length) {
+        if constexpr (DYNAMIC) data.resize(ga_parameters.gene_size);
+        for (size_t i = 0; i < size(); ++i) {
             data[i] = Square(
-                Point(random_real(0, BOX_SIDE_LENGTH), random_real(0, BOX_SIDE_LENGTH)),
+                Point(random_real(0, box_side), random_real(0, box_side)),
                 random_real(0, 2 * M_PI),
                 SQUARE_SIDE_LENGTH
             );
         }
+        stale_squares.set();
+    }
+
+    explicit BasicGene(UninitializedGene) : data{}, fitness(std::numeric_limits<double>::max()), box_side(ga_parameters.box_side_length) {
+        if constexpr (DYNAMIC) data.resize(ga_parameters.gene_size);
+        stale_squares.set();
+    }
+
+    size_t size() const {
+        if constexpr (DYNAMIC) return data.size();
+        return N;
+    }
+    size_t pairCount() const { return size() * (size() - 1) / 2; }
+
+    static constexpr size_t pairIndex(size_t i, size_t j) { // i < j
+        return i * N - i * (i + 1) / 2 + (j - i - 1);
+    }
+
+    void markChanged(size_t i) {
+        dirty = true;
+        if constexpr (DELTA) stale_squares.set(i);
+    }
+
+    // Changes only the box: the bounds terms go stale while the cached pairs stay valid. Its caller is
+    // the box mutation in mutate_gene, which has rescaled the squares first; cross_into merges the
+    // parents' caches itself and marks the bounds stale there when the parents' boxes differ.
+    void setBoxSide(number side) {
+        box_side = side;
+        dirty = true;
+        if constexpr (DELTA) stale_bounds = true;
+    }
+
+    // The container the squares are scored in
+    number boxSide() const { return ga_parameters.variable_box ? box_side : ga_parameters.box_side_length; }
+
+    // The score for these penalties: weighted as usual, plus the box side when it is evolved
+    double fitnessFor(double overlap_penalty, double bounds_penalty) const {
+        const double penalty = ga_parameters.fitness(overlap_penalty, bounds_penalty);
+        return ga_parameters.variable_box ? box_side + penalty : penalty;
+    }
+
+    // Exactly scored with an unweighted penalty (overlap plus area outside the box) of at most
+    // `tolerance`, so the threshold does not move with the penalty weights
+    bool isFeasible(double tolerance = 0.0) const {
+        if (dirty) return false;
+        const double weighted = fitness - (ga_parameters.variable_box ? box_side : 0.0);
+        const double heaviest = max(ga_parameters.overlap_weight, ga_parameters.out_of_bounds_weight);
+        if (weighted > tolerance * heaviest) return false; // Cheap reject: no weight is larger
+        return rawPenalty() <= tolerance;
+    }
+
+    // Overlap plus area outside the box, unweighted
+    double rawPenalty() const {
+        double bounds_penalty = 0.0;
+        if (cacheIsFresh()) {
+            for (number area : bounds_term) bounds_penalty += area;
+        } else {
+            for (size_t i = 0; i < size(); ++i) bounds_penalty += areaOutsideBox(data[i], boxSide());
+        }
+        return overlapArea() + bounds_penalty;
+    }
+
+    // Nothing stale in the delta cache, so calculateFitness() only has to sum it
+    bool cacheIsFresh() const {
+        return DELTA && stale_squares.none() && stale_pairs.none() && !stale_bounds;
+    }
+
+    // Fitness cache key: the squares plus everything else the score depends on
+    uint64_t contentHash() const {
+        uint64_t seed = hashCombine(std::bit_cast<uint32_t>(boxSide()), active_overlap_kernel - overlap_kernels);
+        seed = hashCombine(seed, ga_parameters.variable_box);
+        seed = hashCombine(seed, std::bit_cast<uint64_t>(ga_parameters.overlap_weight));
+        seed = hashCombine(seed, std::bit_cast<uint64_t>(ga_parameters.out_of_bounds_weight));
+        return hashSquares(seed, data, size()) | 1;
     }
 
+    // Takes the exact score from this thread's fitness cache, if these squares were scored recently
+    bool lookupFitness(uint64_t key) {
+        const bool hit = fitness_cache.lookup(key, fitness);
+        fitness_cache_counters.count(hit);
+        if (!hit) return false;
+        dirty = false;
+        return true;
+    }
+
+    // Scores the gene exactly; a clean gene keeps its score. A fresh delta cache is cheaper to sum than
+    // to hash, so only genes with real work to do go through the fitness cache.
     void calculateFitness() {
+        if (!dirty) return;
+        if (USE_FITNESS_CACHE && !cacheIsFresh()) {
+            const uint64_t key = contentHash();
+            if (lookupFitness(key)) return;
+            computeFitness();
+            fitness_cache.store(key, fitness);
+            return;
+        }
+        computeFitness();
+    }
+
+    // Like calculateFitness(), but gives up once the running penalty passes `bound` and returns false:
+    // fitness is then only a lower bound above `bound` and the gene stays dirty. Pairs that can overlap
+    // at all are scored closest first, so a bad child usually gives up within a few pairs. Whatever was
+    // scored before giving up stays in the delta cache. A full score above `bound` (from the fitness
+    // cache, or from the grid, which is not bounded) is left dirty too, so that every gene that gave up
+    // is worse than every gene that did not.
+    bool calculateFitnessBounded(double bound) {
+        if (!dirty) return true;
+        uint64_t key = 0;
+        if (USE_FITNESS_CACHE && !cacheIsFresh()) {
+            key = contentHash();
+            if (lookupFitness(key)) {
+                dirty = fitness > bound;
+                return !dirty;
+            }
+        }
+        if (size() > SPATIAL_HASH_THRESHOLD) { // The grid already skips far pairs
+            computeFitness();
+            if (key) fitness_cache.store(key, fitness);
+            dirty = fitness > bound;
+            return !dirty;
+        }
+
+        // Bounds and already cached pairs first: they cost next to nothing
         double overlap_penalty = 0.0;
         double bounds_penalty = 0.0;
-        
-        const Square container_box(Point(BOX_SIDE_LENGTH / 2.0, BOX_SIDE_LENGTH / 2.0), 0, BOX_SIDE_LENGTH);
-        const Point box_center(BOX_SIDE_LENGTH / 2.0, BOX_SIDE_LENGTH / 2.0);
-        for (size_t i = 0; i < GENE_SIZE; ++i) {
+        for (size_t i = 0; i < size(); ++i) {
+            if constexpr (DELTA) {
+                if (stale_squares[i] || stale_bounds) bounds_term[i] = areaOutsideBox(data[i], boxSide());
+                if (stale_squares[i]) {
+                    for (size_t j = 0; j < N; ++j) {
+                        if (j != i) stale_pairs.set(i < j ? pairIndex(i, j) : pairIndex(j, i));
+                    }
+                }
+                bounds_penalty += bounds_term[i];
+            } else {
+                bounds_penalty += areaOutsideBox(data[i], boxSide());
+            }
+        }
+        if constexpr (DELTA) {
+            stale_squares.reset();
+            stale_bounds = false;
+            for (size_t p = 0; p < CACHED_PAIRS; ++p) {
+                if (!stale_pairs[p]) overlap_penalty += pair_overlap[p];
+            }
+        }
+        if (fitnessFor(overlap_penalty, bounds_penalty) > bound) {
+            fitness = fitnessFor(overlap_penalty, bounds_penalty);
+            return false;
+        }
+
+        // Pairs whose bounding circles meet, closest first; the rest cannot overlap
+        struct Candidate { number distance2; uint16_t i, j; };
+        thread_local vector<Candidate> candidates;
+        candidates.clear();
+        for (size_t i = 0; i < size(); ++i) {
+            for (size_t j = i + 1; j < size(); ++j) {
+                if constexpr (DELTA) {
+                    const size_t p = pairIndex(i, j);
+                    if (!stale_pairs[p]) continue;
+                    if (!boundingCirclesOverlap(data[i], data[j])) {
+                        pair_overlap[p] = 0.0;
+                        stale_pairs.reset(p);
+                        continue;
+                    }
+                } else if (!boundingCirclesOverlap(data[i], data[j])) {
+                    continue;
+                }
+                const number dx = data[j].c.x - data[i].c.x, dy = data[j].c.y - data[i].c.y;
+                candidates.push_back({ dx * dx + dy * dy, static_cast<uint16_t>(i), static_cast<uint16_t>(j) });
+            }
+        }
+        sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.distance2 < b.distance2; });
+
+        const OverlapKernel& kernel = *active_overlap_kernel;
+        CullingStats culling;
+        bool complete = true;
+        for (const Candidate& candidate : candidates) {
+            const number area = kernel.pair(data[candidate.i], data[candidate.j], culling);
+            if constexpr (DELTA) {
+                const size_t p = pairIndex(candidate.i, candidate.j);
+                pair_overlap[p] = area;
+                stale_pairs.reset(p);
+            }
+            overlap_penalty += area;
+            if (area > 0 && fitnessFor(overlap_penalty, bounds_penalty) > bound) {
+                complete = false;
+                break;
+            }
+        }
+        culling_counters.merge(culling);
+        fitness = fitnessFor(overlap_penalty, bounds_penalty);
+        if (!complete) return false;
+
+        dirty = false;
+        if (key) fitness_cache.store(key, fitness);
+        if (overlap_kernel_check.sample()) overlap_kernel_check.compare(data, size(), overlap_penalty);
+        return true;
+    }
+
+    // Cheap stand-in for calculateFitness(): each overlapping pair costs its penetration depth times
+    // a side length instead of its area. Only sets `surrogate`; fitness, dirty and the delta cache are
+    // left as they are.
+    void calculateSurrogateFitness() {
+        double overlap_penalty = 0.0;
+        double bounds_penalty = 0.0;
+        for (size_t i = 0; i < size(); ++i) {
+            for (size_t j = i + 1; j < size(); ++j) {
+                overlap_penalty += penetrationDepthOfSquares(data[i], data[j]) * min(data[i].l, data[j].l);
+            }
+            bounds_penalty += areaOutsideBox(data[i], boxSide());
+        }
+        surrogate = fitnessFor(overlap_penalty, bounds_penalty);
+    }
+
+    // Total overlap between the squares, which does not depend on the container: summed from a fresh
+    // delta cache, or computed from scratch without touching the cache
+    double overlapArea() const {
+        double overlap_penalty = 0.0;
+        if (cacheIsFresh()) {
+            for (number area : pair_overlap) overlap_penalty += area;
+            return overlap_penalty;
+        }
+        const OverlapKernel& kernel = *active_overlap_kernel;
+        CullingStats culling;
+        if (size() > SPATIAL_HASH_THRESHOLD) {
+            thread_local SpatialHash grid;
+            grid.build(data, size(), boxSide(), SPATIAL_HASH_CELL_SIZE);
+            grid.forEachCandidatePair([&](int i, int j) {
+                overlap_penalty += kernel.pair(data[i], data[j], culling);
+            });
+        } else if (kernel.simd) {
+            thread_local SoA soa;
+            soa.load(data);
+            overlap_penalty = simd_overlap_kernel.total(soa.lanes());
+        } else {
             // Overlap with other squares
-            for (size_t j = i + 1; j < GENE_SIZE; ++j) {
-                overlap_penalty += areaOfSquareIntersections(data[i], data[j]);
+            for (size_t i = 0; i < size(); ++i) {
+                for (size_t j = i + 1; j < size(); ++j) {
+                    overlap_penalty += kernel.pair(data[i], data[j], culling);
+                }
             }
+        }
+        culling_counters.merge(culling);
+        return overlap_penalty;
+    }
+
+private:
+    void computeFitness() {
+        dirty = false;
+        if constexpr (DELTA) {
+            updateCachedTerms();
+            double overlap_penalty = 0.0;
+            double bounds_penalty = 0.0;
+            for (number area : pair_overlap) overlap_penalty += area;
+            for (number area : bounds_term) bounds_penalty += area;
+            fitness = fitnessFor(overlap_penalty, bounds_penalty);
+            if (overlap_kernel_check.sample()) overlap_kernel_check.compare(data, size(), overlap_penalty);
+            return;
+        }
+
+        const double overlap_penalty = overlapArea();
+        double bounds_penalty = 0.0;
+        for (size_t i = 0; i < size(); ++i) {
             // Penalty for being outside the container
             // This should be avoided by the mutate() functions, but this works as a last fallback
-            number intersection_with_box = areaOfSquareIntersections(data[i], container_box);
-            number square_area = data[i].l * data[i].l;
-            bounds_penalty += (square_area - intersection_with_box);
+            bounds_penalty += areaOutsideBox(data[i], boxSide());
+        }
+        fitness = fitnessFor(overlap_penalty, bounds_penalty);
+        if (overlap_kernel_check.sample()) overlap_kernel_check.compare(data, size(), overlap_penalty);
+    }
+
+    // Re-scores the stale squares one row at a time, then whatever stale pairs are left one by one
+    void updateCachedTerms() {
+        const OverlapKernel& kernel = *active_overlap_kernel;
+        CullingStats culling;
+        if (stale_squares.any()) {
+            const SquaresSoA<N> soa(data);
+            alignas(32) number row[SquaresSoA<N>::PADDED_SIZE];
+            for (size_t i = 0; i < N; ++i) {
+                if (!stale_squares[i]) continue;
+                if (kernel.simd) {
+                    simd_overlap_kernel.row(soa.lanes(), i, 0, row);
+                } else {
+                    for (size_t j = 0; j < N; ++j) {
+                        row[j] = (j == i) ? 0 : kernel.pair(data[i], data[j], culling);
+                    }
+                }
+                for (size_t j = 0; j < N; ++j) {
+                    if (j == i) continue;
+                    const size_t p = (i < j) ? pairIndex(i, j) : pairIndex(j, i);
+                    pair_overlap[p] = row[j];
+                    stale_pairs.reset(p);
+                }
+                bounds_term[i] = areaOutsideBox(data[i], boxSide());
+            }
+            stale_squares.reset();
+        }
+        if (stale_bounds) {
+            for (size_t i = 0; i < N; ++i) bounds_term[i] = areaOutsideBox(data[i], boxSide());
+            stale_bounds = false;
+        }
+        if (stale_pairs.any()) {
+            for (size_t i = 0; i < N; ++i) {
+                for (size_t j = i + 1; j < N; ++j) {
+                    const size_t p = pairIndex(i, j);
+                    if (!stale_pairs[p]) continue;
+                    pair_overlap[p] = kernel.pair(data[i], data[j], culling);
+                }
+            }
+            stale_pairs.reset();
+        }
+        culling_counters.merge(culling);
+    }
+};
+
+using Gene = BasicGene<GENE_SIZE>;
+
+// Scores population[slots[0, count)] with the population-wide SoA kernel: every pair of every individual
+// that needs it, PopulationSoA::BLOCK individuals per call. In delta mode genes with nothing stale only
+// re-sum their cache, and the rest get their whole cache rewritten so later deltas stay coherent.
+// Clean genes and genes found in the fitness cache are skipped. The batch kernel is the closed form,
+// so it only stands in for the simd kernel; with any other kernel active each gene is scored alone.
+template<int N>
+void evaluate_population_soa(vector<BasicGene<N>>& population, const int* slots, size_t count) {
+    if (!active_overlap_kernel->simd) {
+        for (size_t s = 0; s < count; ++s) {
+            population[slots[s]].calculateFitness();
+        }
+        return;
+    }
+    thread_local vector<size_t> pending;
+    thread_local PopulationSoA soa;
+    thread_local vector<number> pairs;
+    thread_local vector<uint64_t> keys;
+    pending.clear();
+    keys.clear();
+    for (size_t s = 0; s < count; ++s) {
+        const size_t k = slots[s];
+        BasicGene<N>& gene = population[k];
+        if (!gene.dirty) continue;
+        if (gene.cacheIsFresh()) {
+            gene.calculateFitness();
+            continue;
+        }
+        if constexpr (USE_FITNESS_CACHE) {
+            keys.push_back(gene.contentHash());
+            if (gene.lookupFitness(keys.back())) {
+                keys.pop_back();
+                continue;
+            }
+        }
+        pending.push_back(k);
+    }
+    if (pending.empty()) return;
+
+    const size_t square_count = population[pending[0]].size();
+    const size_t pair_count = population[pending[0]].pairCount();
+    soa.load(pending.size(), square_count, [&](size_t k, size_t i) -> const Square& { return population[pending[k]].data[i]; });
+    pairs.resize(pair_count * PopulationSoA::BLOCK);
+    for (size_t first = 0; first < pending.size(); first += PopulationSoA::BLOCK) {
+        population_pairs_kernel(soa, first, pairs.data());
+        for (size_t lane = 0; lane < PopulationSoA::BLOCK && first + lane < pending.size(); ++lane) {
+            BasicGene<N>& gene = population[pending[first + lane]];
+            double overlap_penalty = 0.0;
+            double bounds_penalty = 0.0;
+            for (size_t p = 0; p < pair_count; ++p) {
+                const number area = pairs[p * PopulationSoA::BLOCK + lane];
+                if constexpr (BasicGene<N>::DELTA) gene.pair_overlap[p] = area;
+                overlap_penalty += area;
+            }
+            for (size_t i = 0; i < square_count; ++i) {
+                const number area = areaOutsideBox(gene.data[i], gene.boxSide());
+                if constexpr (BasicGene<N>::DELTA) gene.bounds_term[i] = area;
+                bounds_penalty += area;
+            }
+            if constexpr (BasicGene<N>::DELTA) {
+                gene.stale_squares.reset();
+                gene.stale_pairs.reset();
+                gene.stale_bounds = false;
+            }
+            gene.fitness = gene.fitnessFor(overlap_penalty, bounds_penalty);
+            gene.dirty = false;
+            if constexpr (USE_FITNESS_CACHE) fitness_cache.store(keys[first + lane], gene.fitness);
+            if (overlap_kernel_check.sample()) overlap_kernel_check.compare(gene.data, square_count, overlap_penalty);
+        }
+    }
+}
+
+// Fitness of `gene` in each of `count` containers from a single overlap computation, since only the
+// bounds term depends on the container. Squares that fit in a box also fit in every larger one, so
+// each square is measured once and only re-scored for the sides it does not fit.
+template<int N>
+void fitness_for_box_sides(const BasicGene<N>& gene, const number* box_sides, size_t count, double* fitness) {
+    const double overlap_penalty = gene.overlapArea();
+    thread_local vector<number> needed_side; // Smallest side that holds the square, or infinity
+    needed_side.resize(gene.size());
+    for (size_t i = 0; i < gene.size(); ++i) {
+        const Square& sq = gene.data[i];
+        const number reach = (fabs(sq.cos_t) + fabs(sq.sin_t)) * sq.l / 2.0;
+        const bool fits_low = sq.c.x - reach >= 0 && sq.c.y - reach >= 0;
+        needed_side[i] = fits_low ? max(sq.c.x, sq.c.y) + reach : std::numeric_limits<number>::infinity();
+    }
+    for (size_t b = 0; b < count; ++b) {
+        double bounds_penalty = 0.0;
+        for (size_t i = 0; i < gene.size(); ++i) {
+            if (needed_side[i] > box_sides[b]) bounds_penalty += areaOutsideBox(gene.data[i], box_sides[b]);
+        }
+        fitness[b] = ga_parameters.fitness(overlap_penalty, bounds_penalty);
+    }
+}
+
+// Scores every gene against every side in `box_sides`: fitness[k * box_sides.size() + b] is gene k in
+// a box of side box_sides[b]. The genes and their caches are left as they are.
+template<int N>
+void evaluate_population_for_box_sides(const vector<BasicGene<N>>& population, const vector<number>& box_sides,
+                                       vector<double>& fitness, ThreadPool& pool) {
+    fitness.resize(population.size() * box_sides.size());
+    pool.run([&](unsigned int worker) {
+        auto [start, end] = pool.chunk(population.size(), worker);
+        for (size_t k = start; k < end; ++k) {
+            fitness_for_box_sides(population[k], box_sides.data(), box_sides.size(), &fitness[k * box_sides.size()]);
         }
-        fitness = (overlap_penalty * OVERLAP_WEIGHT) + bounds_penalty * OUT_OF_BOUNDS_WEIGHT;
+    });
+}
+
+// How well the surrogate ranking matched the exact one, over the audited generations
+struct SurrogateCounters {
+    std::atomic<unsigned long long> exact_evaluations{0}, surrogate_evaluations{0};
+    std::atomic<unsigned long long> audited_pairs{0}, discordant_pairs{0};
+    std::atomic<unsigned long long> audited_elites{0}, missed_elites{0};
+
+    void report() const {
+        if (surrogate_evaluations == 0) return;
+        printf("Surrogate fitness over %llu evaluations (%llu exact):\n", surrogate_evaluations.load(), exact_evaluations.load());
+        if (audited_pairs == 0) return;
+        printf("  ranking disagreements %llu of %llu pairs (%.2f%%)\n", discordant_pairs.load(), audited_pairs.load(),
+               100.0 * discordant_pairs / audited_pairs);
+        printf("  exact elites not promoted %llu of %llu (%.2f%%)\n", missed_elites.load(), audited_elites.load(),
+               100.0 * missed_elites / audited_elites);
     }
 };
 
+inline SurrogateCounters surrogate_counters;
+
+// Scores the population in two passes: the surrogate for everyone, then the exact fitness for the
+// best SURROGATE_EXACT_RATE of them. Everyone else stays dirty with only its surrogate, which
+// BasicPopulation::packFitness ranks behind the worst exactly scored gene, so only exact scores ever
+// compete for the elite slots. Clean genes keep their exact score, and genes with a fresh delta cache
+// or a fitness cache entry are scored exactly up front, since that is cheaper still. Audited
+// generations also take the surrogate of those, to compare, and score every other gene exactly.
+template<int N>
+void evaluate_with_surrogate(vector<BasicGene<N>>& population, ThreadPool& pool) {
+    const size_t count = population.size();
+    auto for_chunks = [&](size_t total, auto&& f) {
+        pool.run([&](unsigned int worker) {
+            auto [start, end] = pool.chunk(total, worker);
+            for (size_t j = start; j < end; ++j) f(j);
+        });
+    };
+
+    const bool audit = random_real(0, 1) < SURROGATE_AUDIT_PROBABILITY;
+    vector<char> exact(count, false); // Scored exactly up front
+    for_chunks(count, [&](size_t j) {
+        BasicGene<N>& gene = population[j];
+        if (!gene.dirty || gene.cacheIsFresh() || (USE_FITNESS_CACHE && gene.lookupFitness(gene.contentHash()))) {
+            gene.calculateFitness();
+            exact[j] = true;
+            if (!audit) return;
+        }
+        gene.calculateSurrogateFitness();
+    });
+
+    vector<size_t> order; // Genes still on surrogate scores, best first
+    for (size_t j = 0; j < count; ++j) {
+        if (!exact[j]) order.push_back(j);
+    }
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return population[a].surrogate < population[b].surrogate; });
+
+    const size_t cut = min(order.size(), max<size_t>(static_cast<size_t>(order.size() * SURROGATE_EXACT_RATE), 1));
+    const size_t promoted = audit ? order.size() : cut;
+    for_chunks(promoted, [&](size_t j) { population[order[j]].calculateFitness(); });
+
+    surrogate_counters.surrogate_evaluations += audit ? count : order.size();
+    surrogate_counters.exact_evaluations += promoted;
+
+    if (audit) {
+        // Kendall-style count of pairs the two scores order differently, and of exact elites the
+        // normal promotion cut would have left on surrogate scores
+        unsigned long long pairs = 0, discordant = 0;
+        for (size_t a = 0; a < count; ++a) {
+            for (size_t b = a + 1; b < count; ++b) {
+                const double ds = population[a].surrogate - population[b].surrogate;
+                const double de = population[a].fitness - population[b].fitness;
+                ++pairs;
+                if ((ds < 0 && de > 0) || (ds > 0 && de < 0)) ++discordant;
+            }
+        }
+        const size_t elite_count = min<size_t>(count, ga_parameters.eliteCount());
+        vector<size_t> by_exact(count);
+        for (size_t j = 0; j < count; ++j) by_exact[j] = j;
+        sort(by_exact.begin(), by_exact.end(), [&](size_t a, size_t b) { return population[a].fitness < population[b].fitness; });
+        vector<char> within_cut = exact;
+        for (size_t j = 0; j < cut; ++j) within_cut[order[j]] = true;
+        unsigned long long missed = 0;
+        for (size_t j = 0; j < elite_count; ++j) {
+            if (!within_cut[by_exact[j]]) ++missed;
+        }
+        surrogate_counters.audited_pairs += pairs;
+        surrogate_counters.discordant_pairs += discordant;
+        surrogate_counters.audited_elites += elite_count;
+        surrogate_counters.missed_elites += missed;
+    }
+}
+
 // --- Genetic Algorithm Functions ---
 
-Gene cross(const Gene& parent1, const Gene& parent2) {
-    Gene child;
-    for (size_t i = 0; i < GENE_SIZE; ++i) {
-        child.data[i] = (random_real(0, 1) < 0.5) ? parent1.data[i] : parent2.data[i];
+// Pairs whose squares both come from the same parent keep that parent's cached overlap;
+// only the pairs that mix the parents are left stale. A child that took every square from one parent
+// is a copy of it and keeps its score. In variable-box mode the child takes either parent's box, and
+// its bounds terms are only kept if both parents' boxes agree. Overwrites every field of `child`.
+template<int N>
+void cross_into(const BasicGene<N>& parent1, const BasicGene<N>& parent2, BasicGene<N>& child) {
+    bitset<BasicGene<N>::CACHED_SQUARES> from_second;
+    size_t second_count = 0;
+    for (size_t i = 0; i < child.size(); ++i) {
+        const bool second = !(random_real(0, 1) < 0.5);
+        if constexpr (BasicGene<N>::DELTA) from_second[i] = second;
+        second_count += second;
+        child.data[i] = second ? parent2.data[i] : parent1.data[i];
+    }
+    if (second_count == 0 || second_count == child.size()) {
+        const BasicGene<N>& parent = second_count ? parent2 : parent1;
+        child.fitness = parent.fitness;
+        child.dirty = parent.dirty;
+        child.surrogate = parent.surrogate;
+        child.box_side = parent.box_side;
+    } else {
+        child.fitness = std::numeric_limits<double>::max();
+        child.dirty = true;
+        child.surrogate = std::numeric_limits<double>::max();
+        child.box_side = (ga_parameters.variable_box && random_real(0, 1) < 0.5) ? parent2.box_side : parent1.box_side;
+    }
+    if constexpr (BasicGene<N>::DELTA) {
+        child.stale_squares.reset();
+        child.stale_pairs.reset();
+        child.stale_bounds = parent1.stale_bounds || parent2.stale_bounds
+                             || (ga_parameters.variable_box && parent1.box_side != parent2.box_side);
+        for (size_t i = 0; i < N; ++i) {
+            const BasicGene<N>& parent = from_second[i] ? parent2 : parent1;
+            child.bounds_term[i] = parent.bounds_term[i];
+            child.stale_squares[i] = parent.stale_squares[i];
+            for (size_t j = i + 1; j < N; ++j) {
+                const size_t p = BasicGene<N>::pairIndex(i, j);
+                if (from_second[i] != from_second[j]) {
+                    child.stale_pairs.set(p);
+                } else {
+                    child.pair_overlap[p] = parent.pair_overlap[p];
+                    child.stale_pairs[p] = parent.stale_pairs[p];
+                }
+            }
+        }
     }
-    return child;
 }
 
 // Creates a gene with squares arranged in a grid.
 // This is the obvious, trivial solution for any grid with L^2 > NUMBER_SQUARES
-Gene createGridGene() {
-    Gene gridGene;
-    int grid_dim = ceil(sqrt(GENE_SIZE)); 
-    if(grid_dim * SQUARE_SIDE_LENGTH > BOX_SIDE_LENGTH){
-        return Gene(); // Return a random gene if the grid doesn't fit
+template<int N = GENE_SIZE>
+BasicGene<N> createGridGene() {
+    BasicGene<N> gridGene;
+    const int gene_size = gridGene.size();
+    const number box_side = ga_parameters.box_side_length;
+    int grid_dim = ceil(sqrt(gene_size)); 
+    if(grid_dim * SQUARE_SIDE_LENGTH > box_side){
+        return BasicGene<N>(); // Return a random gene if the grid doesn't fit
     }
     const number spacing = SQUARE_SIDE_LENGTH;
     number grid_total_size = grid_dim * spacing;
-    number start_offset = max(0.0, (double)(BOX_SIDE_LENGTH - grid_total_size) / 2.0);
+    number start_offset = max(0.0, (double)(box_side - grid_total_size) / 2.0);
     number center_offset = spacing / 2.0;
 
     int square_index = 0;
-    for (int i = 0; i < grid_dim && square_index < GENE_SIZE; ++i) {
-        for (int j = 0; j < grid_dim && square_index < GENE_SIZE; ++j) {
+    for (int i = 0; i < grid_dim && square_index < gene_size; ++i) {
+        for (int j = 0; j < grid_dim && square_index < gene_size; ++j) {
             number pos_x = start_offset + (j * spacing) + center_offset;
             number pos_y = start_offset + (i * spacing) + center_offset;
             gridGene.data[square_index].c = Point(pos_x, pos_y);
             gridGene.data[square_index].t = 0.0;
+            gridGene.data[square_index].refresh();
             square_index++;
         }
     }
     return gridGene;
 }
 
-vector<Gene> initializeGenes() {
-    vector<Gene> population;
-    population.reserve(POPULATION_SIZE);
-    population.push_back(createGridGene());
+// Unranked: Population::rank() orders it
+template<int N = GENE_SIZE>
+vector<BasicGene<N>> initializeGenes() {
+    vector<BasicGene<N>> population;
+    population.reserve(ga_parameters.population_size);
+    population.push_back(createGridGene<N>());
     
-    for (int i = 1; i < POPULATION_SIZE; ++i) {
-        population.push_back(Gene());
+    for (int i = 1; i < ga_parameters.population_size; ++i) {
+        population.push_back(BasicGene<N>());
     }
     for (auto& gene : population) {
         gene.calculateFitness();
     }
-    sort(population.begin(), population.end(), [](const Gene& a, const Gene& b) {
-        return a.fitness < b.fitness;
-    });
 
     return population;
 }
 
 // Standalone mutation function to be called from threads. 
 
-void mutate_gene(Gene& gene, double rate) {
-    for (size_t j = 0; j < GENE_SIZE; ++j) {
+// Maps the squares from a box of side `from` into one of side `to`, keeping each square's distance to
+// the walls in proportion. A square with no room to move in the old box goes to the middle of the new one.
+template<int N>
+void rescale_squares(BasicGene<N>& gene, number from, number to) {
+    for (size_t i = 0; i < gene.size(); ++i) {
+        Square& sq = gene.data[i];
+        const number margin = sq.l / 2.0;
+        if (from <= 2 * margin) {
+            sq.c = Point(to / 2, to / 2);
+            sq.refresh();
+            gene.markChanged(i);
+            continue;
+        }
+        const number scale = (to - 2 * margin) / (from - 2 * margin);
+        sq.c.x = margin + (sq.c.x - margin) * scale;
+        sq.c.y = margin + (sq.c.y - margin) * scale;
+        sq.refresh();
+        gene.markChanged(i);
+    }
+}
+
+template<int N>
+void mutate_gene(BasicGene<N>& gene, double rate) {
+    if (ga_parameters.variable_box && random_real(0, 1) < BOX_SIDE_MUTATION_PROBABILITY) {
+        const number scale = 1.0 + random_real(-ga_parameters.box_side_step, ga_parameters.box_side_step);
+        // No box smaller than the squares' total area can hold them
+        const number side = max<number>(SQUARE_SIDE_LENGTH * sqrt(gene.size()), gene.box_side * scale);
+        rescale_squares(gene, gene.box_side, side);
+        gene.setBoxSide(side);
+    }
+    const number box_side = gene.boxSide();
+    for (size_t j = 0; j < gene.size(); ++j) {
         if (random_real(0, 1) < rate) {
             int mutation_type = random_integer(0, 2);
             switch(mutation_type) {
                 case 0: // Nudge position
-                    gene.data[j].c.x += random_real(-0.1 * BOX_SIDE_LENGTH, 0.1 * BOX_SIDE_LENGTH);
-                    gene.data[j].c.y += random_real(-0.1 * BOX_SIDE_LENGTH, 0.1 * BOX_SIDE_LENGTH);
+                    gene.data[j].c.x += random_real(-0.1 * box_side, 0.1 * box_side);
+                    gene.data[j].c.y += random_real(-0.1 * box_side, 0.1 * box_side);
                     break;
                 case 1: // Jump to a new position
-                    gene.data[j].c.x = random_real(0, BOX_SIDE_LENGTH);
-                    gene.data[j].c.y = random_real(0, BOX_SIDE_LENGTH);
+                    gene.data[j].c.x = random_real(0, box_side);
+                    gene.data[j].c.y = random_real(0, box_side);
                     break;
                 case 2: // Change rotation
-                    if (random_real(0, 1) < ROTATIONAL_SNAP_PROBABILITY) {
+                    if (random_real(0, 1) < ga_parameters.rotational_snap_probability) {
                         gene.data[j].t = round(gene.data[j].t / (M_PI / 2.0)) * (M_PI / 2.0);
                     } else {
                         gene.data[j].t = random_real(0, 2 * M_PI);
@@ -161,110 +845,237 @@ void mutate_gene(Gene& gene, double rate) {
                     break;
             }
             // Clamp coordinates to stay within bounds
-            gene.data[j].c.x = max((number)0.0, min(BOX_SIDE_LENGTH, gene.data[j].c.x));
-            gene.data[j].c.y = max((number)0.0, min(BOX_SIDE_LENGTH, gene.data[j].c.y));
+            gene.data[j].c.x = max((number)0.0, min(box_side, gene.data[j].c.x));
+            gene.data[j].c.y = max((number)0.0, min(box_side, gene.data[j].c.y));
+            gene.data[j].refresh();
+            gene.markChanged(j);
         }
     }
 }
 
-// Tournament selection that operates on a provided parent pool.
-const Gene& tournament_selection(const vector<Gene>& parent_pool) {
-    if (parent_pool.empty()) {
-        //This should never happen, since it implies a predation rate of 100 and elitism of 0. 
+// Tournament selection over a packed fitness array, returning the winner's index: the contestants'
+// fitness values sit in one or two cache lines instead of one line per (large) Gene
+size_t tournament_selection(const double* fitness, size_t count) {
+    if (count == 0) {
         throw std::runtime_error("Parent pool for tournament selection is empty!");
     }
-    
-    int best_index = -1;
-    double best_fitness = std::numeric_limits<double>::max();
 
-    for (int i = 0; i < TOURNAMENT_SIZE; ++i) {
-        int random_index = random_integer(0, parent_pool.size() - 1);
-        if (parent_pool[random_index].fitness < best_fitness) {
-            best_fitness = parent_pool[random_index].fitness;
+    size_t best_index = 0;
+    double best_fitness = std::numeric_limits<double>::max();
+    for (int i = 0; i < ga_parameters.tournament_size; ++i) {
+        size_t random_index = random_integer(0, count - 1);
+        if (fitness[random_index] < best_fitness) {
+            best_fitness = fitness[random_index];
             best_index = random_index;
         }
     }
-    return parent_pool[best_index];
+    return best_index;
 }
 
-vector<Gene> evolve_generation(const vector<Gene>& current_population, const unsigned int NUM_THREADS) {
-    //Elitism and predation
-    vector<Gene> survivor_pool;
-    survivor_pool.reserve(POPULATION_SIZE);
+template<int N> struct BasicPopulation;
+template<int N> void evolve_generation(BasicPopulation<N>& population, ThreadPool& pool);
+
+// The population and its ranking. Genes stay in their slots for life: ranking orders slot indices, and
+// only as far as selection needs (the elites, best first; the rest in no particular order).
+template<int N>
+struct BasicPopulation {
+    vector<BasicGene<N>> genes;
+    vector<double> fitness; // genes[k].fitness packed for ranking; see packFitness()
+    vector<double> parent_fitness; // fitness[ranking[r]] of the survivors, packed for tournaments
+    vector<int> ranking;
+
+    explicit BasicPopulation(vector<BasicGene<N>> initial_genes)
+        : genes(std::move(initial_genes)), fitness(genes.size()), parent_fitness(genes.size()), ranking(genes.size()) {
+        rank();
+    }
+
+    const BasicGene<N>& best() const { return genes[ranking[0]]; }
 
-    int elite_count = static_cast<int>(POPULATION_SIZE * ELITISM_RATE);
-    for (int i = 0; i < elite_count; ++i) {
-        survivor_pool.push_back(current_population[i]);
+    // Packs the scores of every gene. A dirty gene only has a lower bound on its score (bounded
+    // evaluation gave up on it) or, in surrogate mode, an estimate, so it is put behind every exact
+    // score, keeping its order among them. This is the only place that offset is applied.
+    void packFitness() {
+        double worst_exact = 0.0;
+        for (size_t k = 0; k < genes.size(); ++k) {
+            fitness[k] = genes[k].fitness;
+            if (!genes[k].dirty) worst_exact = max(worst_exact, fitness[k]);
+        }
+        for (size_t k = 0; k < genes.size(); ++k) {
+            if (genes[k].dirty) fitness[k] = worst_exact + (USE_SURROGATE_FITNESS ? genes[k].surrogate : genes[k].fitness);
+        }
+    }
+
+    // Mean score of the exactly scored genes; the others only have a bound or an estimate
+    double averageFitness() const {
+        double total = 0.0;
+        size_t exact = 0;
+        for (const BasicGene<N>& gene : genes) {
+            if (gene.dirty) continue;
+            total += gene.fitness;
+            ++exact;
+        }
+        return exact > 0 ? total / exact : 0.0;
     }
 
-    vector<int> non_elite_indices;
-    for (size_t i = elite_count; i < current_population.size(); ++i) {
-        non_elite_indices.push_back(i);
+    void rank() {
+        packFitness();
+        for (size_t k = 0; k < genes.size(); ++k) ranking[k] = k;
+        auto better = [this](int a, int b) { return fitness[a] < fitness[b]; };
+        const auto elite_end = ranking.begin() + min<size_t>(max(ga_parameters.eliteCount(), 1), ranking.size());
+        std::nth_element(ranking.begin(), elite_end - 1, ranking.end(), better);
+        sort(ranking.begin(), elite_end, better);
     }
-    shuffle(non_elite_indices.begin(), non_elite_indices.end(), gen);
 
-    int predation_kill_count = static_cast<int>(non_elite_indices.size() * PREDATION_RATE); 
-    int non_elite_survivor_count = non_elite_indices.size() - predation_kill_count; 
-    // Random number of non-elites get eliminated
+    // Replaces the worst genes with `count` outsiders
+    void immigrate(const BasicGene<N>* migrants, size_t count) {
+        for (size_t m = 0; m < count; ++m) {
+            const auto worst = std::max_element(fitness.begin(), fitness.end()) - fitness.begin();
+            genes[worst] = migrants[m];
+            fitness[worst] = migrants[m].fitness;
+        }
+        rank();
+    }
 
-    for (int i = 0; i < non_elite_survivor_count; ++i) {
-        survivor_pool.push_back(current_population[non_elite_indices[i]]);
+    // Rescores and reranks every gene, after a change to how fitness is weighed
+    void rescore(ThreadPool& pool) {
+        pool.run([&](unsigned int worker) {
+            auto [start, end] = pool.chunk(genes.size(), worker);
+            for (size_t k = start; k < end; ++k) {
+                genes[k].dirty = true;
+                genes[k].calculateFitness();
+            }
+        });
+        rank();
     }
 
+    void evolve(ThreadPool& pool) { evolve_generation(*this, pool); }
+};
+
+using Population = BasicPopulation<GENE_SIZE>;
+
+// Breeds the next generation of a ranked population in place. The elites and the non-elites that
+// escape predation stay in their slots, and children are bred straight into the predated slots, which
+// no parent reads from. Only slot indices move in the ranking, so no gene is copied or allocated.
+template<int N>
+void evolve_generation(BasicPopulation<N>& population, ThreadPool& pool) {
+    vector<BasicGene<N>>& genes = population.genes;
+    vector<int>& ranking = population.ranking;
+
+    //Elitism and predation: the non-elite part of the ranking is shuffled and its tail is culled
+    const int elite_count = ga_parameters.eliteCount();
+    shuffle(ranking.begin() + elite_count, ranking.end(), gen);
+    const int predation_kill_count = static_cast<int>((ranking.size() - elite_count) * ga_parameters.predation_rate);
+    const size_t survivor_count = ranking.size() - predation_kill_count;
+    for (size_t r = 0; r < survivor_count; ++r) population.parent_fitness[r] = population.fitness[ranking[r]];
+
     // Mutation and crossover
-    double current_mutation_rate = MUTATION_RATE;
-    if (random_real(0, 1) < DISASTER_PROBABILITY) {
-        current_mutation_rate = DISASTER_HYPERMUTATION_RATE;
+    double current_mutation_rate = ga_parameters.mutation_rate;
+    if (random_real(0, 1) < ga_parameters.disaster_probability) {
+        current_mutation_rate = ga_parameters.disaster_hypermutation_rate;
     }
 
-    vector<Gene> new_population = survivor_pool;
-    int offspring_needed = POPULATION_SIZE - survivor_pool.size();
-    
-    if (offspring_needed > 0) {
-        vector<std::thread> workers;
-        std::mutex new_population_mutex;
-        size_t chunk_size = offspring_needed / NUM_THREADS;
-
-        for (unsigned int i = 0; i < NUM_THREADS; ++i) {
-            size_t num_to_create = (i == NUM_THREADS - 1) ? (offspring_needed - (i * chunk_size)) : chunk_size;
-            
-            workers.emplace_back([&, num_to_create, current_mutation_rate]() {
-                vector<Gene> offspring_batch;
-                offspring_batch.reserve(num_to_create);
-                for (size_t j = 0; j < num_to_create; ++j) {
-                    const Gene& parent1 = tournament_selection(survivor_pool);
-                    const Gene& parent2 = tournament_selection(survivor_pool);
-                    Gene child = cross(parent1, parent2);
-                    mutate_gene(child, current_mutation_rate);
-                    offspring_batch.push_back(child);
-                }
-                
-                std::lock_guard<std::mutex> guard(new_population_mutex);
-                new_population.insert(new_population.end(), offspring_batch.begin(), offspring_batch.end());
-            });
+    // Each task selects, crosses, mutates and scores one child while it is still in cache. Tasks are
+    // stolen between workers, since the cost of scoring a child varies a lot. Survivors keep the
+    // fitness they were ranked with, so only children are scored. The batch evaluators need every
+    // child first, so with them the tasks only breed and scoring follows as a second phase.
+    constexpr bool FUSED_SCORING = !USE_POPULATION_SOA && !USE_SURROGATE_FITNESS;
+    const size_t offspring_needed = predation_kill_count;
+    const int* child_slots = ranking.data() + survivor_count;
+    // Children are scored only until they are sure to be worse than every exactly scored survivor.
+    // Finished children never exceed that bound either, so the exact scores only ever improve and an
+    // unfinished gene stays behind all of them for life: ranking it last is exact, not a guess.
+    double survivor_bound = 0.0;
+    size_t exact_survivors = 0;
+    for (size_t r = 0; r < survivor_count; ++r) {
+        const BasicGene<N>& survivor = genes[ranking[r]];
+        if (survivor.dirty) continue;
+        survivor_bound = max(survivor_bound, survivor.fitness);
+        ++exact_survivors;
+    }
+    if (exact_survivors == 0) survivor_bound = std::numeric_limits<double>::max();
+    pool.distributeTasks(offspring_needed);
+    pool.run([&](unsigned int worker) {
+        size_t task;
+        while (pool.nextTask(worker, task)) {
+            const BasicGene<N>& parent1 = genes[ranking[tournament_selection(population.parent_fitness.data(), survivor_count)]];
+            const BasicGene<N>& parent2 = genes[ranking[tournament_selection(population.parent_fitness.data(), survivor_count)]];
+            BasicGene<N>& child = genes[child_slots[task]];
+            cross_into(parent1, parent2, child);
+            mutate_gene(child, current_mutation_rate);
+            if constexpr (FUSED_SCORING && USE_BOUNDED_EVALUATION) child.calculateFitnessBounded(survivor_bound);
+            else if constexpr (FUSED_SCORING) child.calculateFitness();
         }
-        for (auto& worker : workers) { worker.join(); }
-    }
-    {
-        vector<std::thread> workers;
-        size_t chunk_size = new_population.size() / NUM_THREADS;
-        for (unsigned int i = 0; i < NUM_THREADS; ++i) {
-            size_t start = i * chunk_size;
-            size_t end = (i == NUM_THREADS - 1) ? new_population.size() : start + chunk_size;
-            workers.emplace_back([&new_population, start, end]() {
-                for (size_t j = start; j < end; ++j) {
-                    new_population[j].calculateFitness();
-                }
-            });
+
+        if constexpr (USE_POPULATION_SOA && !USE_SURROGATE_FITNESS) {
+            pool.barrier();
+            auto [start, end] = pool.chunk(offspring_needed, worker);
+            evaluate_population_soa(genes, child_slots + start, end - start);
         }
-        for (auto& worker : workers) { worker.join(); }
+    });
+    if constexpr (USE_SURROGATE_FITNESS) {
+        evaluate_with_surrogate(genes, pool);
     }
-    
-    sort(new_population.begin(), new_population.end(), [](const Gene& a, const Gene& b) {
-        return a.fitness < b.fitness;
+
+    population.rank();
+}
+
+// Checks a ranking against exact scores: every gene is scored exactly on a copy, and the genes the
+// ranking misplaces are counted. Those are the elites whose exact score is not the one at their rank,
+// and the unfinished genes that are in fact better than some exactly scored gene, since packFitness()
+// puts them behind all of those. Pair areas are floats and are summed in whatever order the scoring
+// went, so scores within float rounding of each other count as ties.
+template<int N>
+size_t count_misranked(const BasicPopulation<N>& population) {
+    const size_t count = population.genes.size();
+    vector<double> exact(count);
+    double worst_clean = 0.0;
+    for (size_t k = 0; k < count; ++k) {
+        BasicGene<N> copy = population.genes[k];
+        copy.dirty = true;
+        copy.calculateFitness();
+        exact[k] = copy.fitness;
+        if (!population.genes[k].dirty) worst_clean = max(worst_clean, exact[k]);
+    }
+    vector<double> sorted = exact;
+    sort(sorted.begin(), sorted.end());
+    auto rounding = [](double score) { return 1e-6 * max(1.0, fabs(score)); };
+
+    size_t misranked = 0;
+    const size_t elite_count = min<size_t>(max(ga_parameters.eliteCount(), 1), count);
+    for (size_t r = 0; r < elite_count; ++r) {
+        if (fabs(exact[population.ranking[r]] - sorted[r]) > rounding(sorted[r])) ++misranked;
+    }
+    for (size_t k = 0; k < count; ++k) {
+        if (population.genes[k].dirty && exact[k] < worst_clean - rounding(worst_clean)) ++misranked;
+    }
+    return misranked;
+}
+
+// Seeds every worker's generator (the caller is worker 0) from one seed. Runs are only repeatable
+// with a single thread, since tasks are stolen in whatever order the scheduler happens to run them.
+void seed_random_generators(ThreadPool& pool, uint64_t seed) {
+    pool.run([seed](unsigned int worker) {
+        gen.seed(seed + 0x9E3779B97F4A7C15ull * worker);
     });
+}
+
+// Calls f(std::integral_constant<int, N>()) with the compiled-in N equal to gene_size, or with
+// DYNAMIC_GENE_SIZE once ga_parameters.gene_size is set to it, and returns what f returns
+template<class F>
+decltype(auto) dispatch_gene_size(int gene_size, F& f, GeneSizeList<>) {
+    ga_parameters.gene_size = gene_size;
+    return f(std::integral_constant<int, DYNAMIC_GENE_SIZE>());
+}
+
+template<class F, int First, int... Rest>
+decltype(auto) dispatch_gene_size(int gene_size, F& f, GeneSizeList<First, Rest...>) {
+    if (gene_size == First) return f(std::integral_constant<int, First>());
+    return dispatch_gene_size(gene_size, f, GeneSizeList<Rest...>());
+}
 
-    return new_population;
+template<class F>
+decltype(auto) with_gene_size(int gene_size, F&& f) {
+    return dispatch_gene_size(gene_size, f, SpecializedGeneSizes());
 }
 
 #endif // EVOLUTION_H
\ No newline at end of file
@@ -5,12 +5,15 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <graphics/Shader.h>
 #include <tools/evolution.h>
+#include <tools/Islands.h>
+#include <tools/SteadyState.h>
 #include <tools/EvolutionData.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <thread>
+#include <chrono>
 #include <mutex>
 #include <atomic>
 #include <numeric>
@@ -29,25 +32,50 @@ std::atomic<size_t> generation_number = 0;
 EvolutionData evolutionData;
 const unsigned int NUM_THREADS = std::thread::hardware_concurrency();
 
+// Drives an engine that evolves on its own threads (islands, steady state), sampling it for display
+template<class Engine>
+void sampling_worker(Engine& engine) {
+    engine.start();
+    Gene best(UNINITIALIZED_GENE);
+    double average_fitness;
+    size_t generations;
+
+    while (is_running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (!engine.snapshot(best, average_fitness, generations)) continue;
+
+        std::lock_guard<std::mutex> guard(data_mutex);
+        shared_squares = best.data;
+        evolutionData.pushGeneration(std::make_pair(best, average_fitness), generations);
+        generation_number = generations;
+    }
+    engine.stop();
+}
+
 void evolution_worker() {
-    vector<Gene> population = initializeGenes();
+    if constexpr (USE_ISLANDS) {
+        IslandModel islands(NUM_THREADS, MIGRATION_TOPOLOGY);
+        sampling_worker(islands); // Generations are summed over all islands
+        return;
+    }
+    if constexpr (USE_STEADY_STATE) {
+        SteadyStateEngine engine(initializeGenes(), NUM_THREADS);
+        sampling_worker(engine);
+        return;
+    }
+    Population population(initializeGenes());
+    ThreadPool pool(NUM_THREADS); // Reused by every generation
 
     while (is_running) {
         // Evolve the population for one generation
-        population = evolve_generation(population, NUM_THREADS);
+        population.evolve(pool);
         
         // Lock the mutex to safely update the shared data for the rendering thread
         {
             std::lock_guard<std::mutex> guard(data_mutex);
-            shared_squares = population[0].data; // population[0] is the best individual
-            
-            double average_fitness = 0.0;
-            for(const Gene& g : population){
-                average_fitness += g.fitness;
-            }
-            average_fitness /= population.size();
+            shared_squares = population.best().data;
             
-            evolutionData.pushGeneration(std::make_pair(population[0], average_fitness), generation_number);
+            evolutionData.pushGeneration(std::make_pair(population.best(), population.averageFitness()), generation_number);
         }
         generation_number++;
     }
@@ -79,6 +107,13 @@ void drawPolygon(Shader& shader, unsigned int VAO, unsigned int VBO, const std::
 
 int main() {
 
+    try {
+        configureOverlapKernelsFromEnvironment();
+    } catch (const std::invalid_argument& e) {
+        std::cout << e.what() << std::endl;
+        return -1;
+    }
+
     if (!glfwInit()) {
         std::cout << "Failed to initialize GLFW" << std::endl;
         return -1;
@@ -114,6 +149,9 @@ int main() {
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Point), (void*)0);
     glEnableVertexAttribArray(0);
 
+    std::cout << "Overlap kernel: " << active_overlap_kernel->name;
+    if (active_overlap_kernel->simd) std::cout << " (" << simd_overlap_kernel.name << ")";
+    std::cout << std::endl;
     std::thread worker(evolution_worker);
     size_t count = 0;
     size_t last_printed_generation = 0;
@@ -136,7 +174,7 @@ int main() {
                 squares_to_draw = shared_squares;
             } 
             if (!squares_to_draw.empty()) { 
-                const float MAGNIFICATION = (SCREEN_SIZE - PADDING * 2) / BOX_SIDE_LENGTH;
+                const float MAGNIFICATION = (SCREEN_SIZE - PADDING * 2) / ga_parameters.box_side_length;
                 bool print = false;
                 if(last_printed_generation != current_generation && current_generation % 100 == 0){
                     printf("\n\n\n");
@@ -163,6 +201,10 @@ int main() {
     is_running = false;
     worker.join();
     glfwTerminate();
+    culling_counters.report();
+    surrogate_counters.report();
+    fitness_cache_counters.report();
+    overlap_kernel_check.report();
     evolutionData.write("evolution_data.dat");
     system("gnuplot -persist plotscript.gp");
     return 0;